@@ -0,0 +1,73 @@
+/*
+ * copyright (c) 2025 Jack Lau
+ *
+ * This file is a example about building a thumbnail sheet through EasyFFmpeg API
+ *
+ * FFmpeg version 5.1.4
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libavutil/time.h>
+#include "../include/easy_mosaic.h"
+#include "../include/easy_trace.h"
+#include "../include/easy_utils.h"
+
+int main(int argc, char **argv)
+{
+    EasyMosaic mosaic;
+    int cols = 10, rows = 10, tile_w = 192;
+    int64_t start;
+    int ret;
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <input file> <output ppm> [cols rows [tile width]]\n"
+                        "       %s <output ppm> -files <input1> <input2> ...\n", argv[0], argv[0]);
+        return 1;
+    }
+    if (getenv("EASY_TRACE"))
+        easy_trace_start(getenv("EASY_TRACE"));
+
+    start = av_gettime_relative();
+    if (!strcmp(argv[2], "-files")) {
+        /* one tile per file, showing its first frame */
+        int nb = argc - 3;
+        EasyMosaicTile *tiles = (EasyMosaicTile *)calloc(nb, sizeof(*tiles));
+
+        if (!tiles || !nb) {
+            free(tiles);
+            return 1;
+        }
+        for (int i = 0; i < nb; i++)
+            tiles[i].filename = argv[3 + i];
+        for (cols = 1; cols * cols < nb; cols++);
+        rows = (nb + cols - 1) / cols;
+        ret = easy_mosaic_init(&mosaic, cols, rows, tile_w, tile_w * 9 / 16, 4);
+        if (ret >= 0 && (ret = easy_mosaic_build(&mosaic, tiles, nb, 0)) < 0)
+            easy_mosaic_uninit(&mosaic);
+        free(tiles);
+    } else {
+        if (argc >= 5) {
+            cols = atoi(argv[3]);
+            rows = atoi(argv[4]);
+        }
+        if (argc >= 6)
+            tile_w = atoi(argv[5]);
+        ret = easy_contact_sheet(&mosaic, argv[1], cols, rows, tile_w, 0);
+    }
+    if (ret < 0) {
+        CHECK_ERROR(ret);
+        goto end;
+    }
+    av_log(NULL, AV_LOG_INFO, "%dx%d sheet built in %.2f s\n", mosaic.cols, mosaic.rows,
+           (av_gettime_relative() - start) / 1000000.0);
+
+    ret = easy_save_frame_to_ppm(mosaic.frame, strcmp(argv[2], "-files") ? argv[2] : argv[1]);
+    easy_mosaic_uninit(&mosaic);
+
+end:
+    if (easy_trace_enabled())
+        easy_trace_stop();
+    return ret < 0;
+}
@@ -5,13 +5,24 @@
  * 
  * FFmpeg version 5.1.4
  */
+#include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 #include <libswscale/swscale.h>
 #include "../include/easy_utils.h"
 #include "../include/easy_media.h"
+#include "../include/easy_scene.h"
+#include "../include/easy_stats.h"
+
+/* only frames that differ from the last saved one are written */
+static EasySceneDetector scene;
+/* per-frame latency and throughput, written to <output>.json at the end */
+static EasyRunStats run_stats;
+/* when the input was opened, to report the first frame latency of live inputs */
+static int64_t open_time = AV_NOPTS_VALUE;
 
 
 void decode(AVCodecContext *dec_ctx, AVFrame *frame, AVPacket *pkt,	FILE *f, char *fileName)
@@ -20,7 +31,7 @@ void decode(AVCodecContext *dec_ctx, AVFrame *frame, AVPacket *pkt,	FILE *f, cha
 	int ret;
 
 	//send packet to decoder
-	ret = avcodec_send_packet(dec_ctx, pkt);
+	ret = easy_send_packet(dec_ctx, pkt);
 	if (ret < 0) {
         CHECK_ERROR(ret);
         return;
@@ -28,7 +39,7 @@ void decode(AVCodecContext *dec_ctx, AVFrame *frame, AVPacket *pkt,	FILE *f, cha
 	while (ret >= 0) {
 		// receive frame from decoder
 		// we may receive multiple frames or we may consume all data from decoder, then return to main loop
-		ret = avcodec_receive_frame(dec_ctx, frame);
+		ret = easy_receive_frame(dec_ctx, frame);
 		if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
 			return;
 		else if (ret < 0) {
@@ -36,6 +47,17 @@ void decode(AVCodecContext *dec_ctx, AVFrame *frame, AVPacket *pkt,	FILE *f, cha
 			CHECK_ERROR(ret);
             return;
 		}
+		easy_run_stats_frame_decoded(&run_stats, frame);
+		if (open_time != AV_NOPTS_VALUE) {
+			av_log(NULL, AV_LOG_INFO, "first frame %.1f ms after opening the input\n",
+			       (av_gettime_relative() - open_time) / 1000.0);
+			open_time = AV_NOPTS_VALUE;
+		}
+		if (easy_scene_is_distinct(&scene, frame) == 0) {
+			printf("skipping near-duplicate frame %" PRId64 "\n", frame->pts);
+			easy_run_stats_frame_done(&run_stats, frame);
+			continue;
+		}
 		//printf("saving frame %3d\n", dec_ctx->pkt_serial);
 		printf("saving frame %lld\n", frame->pts);
         fflush(stdout);
@@ -58,10 +80,9 @@ void decode(AVCodecContext *dec_ctx, AVFrame *frame, AVPacket *pkt,	FILE *f, cha
         //                      frame->data[2],
         //                      frame->width, frame->height, fileName);
         
-        /* save yuv data into ppm using swscale */
-        unsigned char *rgb_buffer = (unsigned char *)malloc(3 * frame->width * frame->height);
-        easy_reformat_to_rgb24(frame, rgb_buffer, frame->width, frame->height, frame->format);
-        easy_save_ppm(rgb_buffer, 3 * frame->width, frame->width, frame->height, fileName);
+        /* save yuv data into ppm honoring the frame's colorspace and range */
+        easy_save_frame_to_ppm(frame, fileName);
+		easy_run_stats_frame_done(&run_stats, frame);
 	}
 }
 
@@ -72,8 +93,9 @@ int main(int argc, char *argv[])
 	AVCodecContext *codec_ctx = NULL;
 	const AVCodec *Codec = NULL;
 	int ret;
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s input output\n", argv[0]);
+    if (argc != 3 && !(argc == 4 && !strcmp(argv[3], "live"))) {
+        fprintf(stderr, "Usage: %s input output [live]\n"
+                        "  live: low-latency mode for pipes, FIFOs and stdin (\"-\")\n", argv[0]);
         exit(1);
     }
 	const char *infilename = argv[1];
@@ -81,11 +103,24 @@ int main(int argc, char *argv[])
 	int VideoStreamIndex = -1;
 
 	FILE *fout = NULL;
+	FILE *fstats = NULL;
+	char stats_name[1024];
 
 	AVFrame *frame = NULL;
 	AVPacket *pkt = NULL;
 
-	easy_open_video(infilename, &fmt_ctx, &codec_ctx, &VideoStreamIndex);
+	// EASY_TRACE=trace.json records a timeline viewable in chrome://tracing or Perfetto
+	if (getenv("EASY_TRACE"))
+		easy_trace_start(getenv("EASY_TRACE"));
+
+	EasyVideoOptions opts = { 0 };
+	opts.live = argc == 4;
+	if (opts.live)
+		open_time = av_gettime_relative();
+	if (easy_open_video2(infilename, &fmt_ctx, &codec_ctx, &VideoStreamIndex, &opts) < 0)
+		goto end;
+	easy_scene_init(&scene, EASY_SCENE_DEFAULT_SAD_THRESHOLD, EASY_SCENE_DEFAULT_HIST_THRESHOLD);
+	easy_run_stats_init(&run_stats, "decode_and_save");
 
 	// dump video stream info
 	av_dump_format(fmt_ctx, VideoStreamIndex, infilename, 0);
@@ -118,7 +153,7 @@ int main(int argc, char *argv[])
 	while (1)
 	{
 		// read an encoded packet from file
-		if ((ret = av_read_frame(fmt_ctx, pkt)) < 0)
+		if ((ret = easy_read_frame(fmt_ctx, pkt)) < 0)
 		{
 			av_log(NULL, AV_LOG_ERROR, "cannot read frame");
 			break;
@@ -126,6 +161,7 @@ int main(int argc, char *argv[])
 		// if packet data is video data then send it to decoder
 		if (pkt->stream_index == VideoStreamIndex)
 		{
+			easy_run_stats_packet_read(&run_stats, pkt);
 			decode(codec_ctx, frame, pkt, fout, outfilename);
 		}
 
@@ -136,6 +172,15 @@ int main(int argc, char *argv[])
 	//flush decoder
 	decode(codec_ctx, frame, NULL, fout, outfilename);
 
+	// write the run report
+	easy_run_stats_finish(&run_stats);
+	snprintf(stats_name, sizeof(stats_name), "%s.json", outfilename);
+	fstats = fopen(stats_name, "w");
+	if (fstats) {
+		easy_run_stats_write_json(&run_stats, fstats);
+		fclose(fstats);
+	}
+
 	// clear and out
 end:
 	if (fout)
@@ -148,6 +193,9 @@ end:
 		av_frame_free(&frame);
 	if (pkt)
 		av_packet_free(&pkt);
+	easy_scene_uninit(&scene);
+	if (easy_trace_enabled())
+		easy_trace_stop();
 
 	return 0;
 }
\ No newline at end of file
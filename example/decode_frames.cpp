@@ -0,0 +1,42 @@
+/*
+ * copyright (c) 2025 Jack Lau
+ *
+ * This file is a example about decoding video frames through the EasyFFmpeg C++ API
+ *
+ * FFmpeg version 5.1.4
+ */
+#include "../include/easy.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "../include/easy_utils.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <input file> [output prefix [every nth frame]]\n", argv[0]);
+        return 1;
+    }
+    const int every = argc >= 4 ? std::atoi(argv[3]) : 100;
+
+    try {
+        easy::Decoder decoder = easy::decode(argv[1]);
+        int64_t count = 0;
+
+        /* nothing to free on any path, the decoder owns its contexts, packet and frame */
+        for (AVFrame &frame : decoder) {
+            if (argc >= 3 && every > 0 && count % every == 0) {
+                std::string name = std::string(argv[2]) + "_" + std::to_string(count) + ".ppm";
+                easy_save_frame_to_ppm(&frame, name.c_str());
+            }
+            count++;
+        }
+        std::printf("%lld frames decoded\n", (long long)count);
+    } catch (const easy::Error &e) {
+        std::fprintf(stderr, "Error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -19,6 +19,9 @@
 const char *filter_descr = 
     "[in0]pad=iw*2:ih[int];[int][in1]overlay=w[out]";
 
+/* bytes of decoded frames that may be buffered in the filter graph at once */
+#define MEMORY_BUDGET (256 * 1024 * 1024)
+
 static AVFormatContext *fmt_ctx1;
 static AVFormatContext *fmt_ctx2;
 static AVCodecContext *dec_ctx1;
@@ -147,6 +150,9 @@ int main(int argc, char **argv)
         fprintf(stderr, "Usage: %s input1 input2 output.yuv\n", argv[0]);
         exit(1);
     }
+    // EASY_TRACE=trace.json records a timeline viewable in chrome://tracing or Perfetto
+    if (getenv("EASY_TRACE"))
+        easy_trace_start(getenv("EASY_TRACE"));
 
     frame1 = av_frame_alloc();
     frame2 = av_frame_alloc();
@@ -157,6 +163,13 @@ int main(int argc, char **argv)
         fprintf(stderr, "Could not allocate frame or packet\n");
         exit(1);
     }
+    EasyRunStats run_stats;
+    easy_run_stats_init(&run_stats, "filtering_video");
+    EasyMemBudget budget;
+    if (easy_mem_budget_init(&budget, MEMORY_BUDGET) < 0) {
+        fprintf(stderr, "Could not initialize memory budget\n");
+        exit(1);
+    }
 
     if ((ret = easy_open_video(argv[1], &fmt_ctx1, &dec_ctx1, &video_stream_index1)) < 0)
         goto end;
@@ -182,17 +195,33 @@ int main(int argc, char **argv)
 
 
     int finished1 = 0, finished2 = 0;
+    double clock1 = 0, clock2 = 0;
     /* read all packets */
     while (!finished1 || !finished2) {
+        /* when the budget is exhausted only the input that is behind may read,
+         * so the one running ahead stops piling frames up in the graph */
+        int over_budget = easy_mem_budget_exceeded(&budget);
+        int throttle1 = over_budget && !finished2 && clock1 > clock2;
+        int throttle2 = over_budget && !finished1 && clock2 > clock1;
+
         // Process video1
-        if (!finished1 && av_read_frame(fmt_ctx1, &packet1) >= 0) {
+        if (throttle1) {
+            // wait for video2 to catch up
+        } else if (!finished1 && easy_read_frame(fmt_ctx1, &packet1) >= 0) {
             if (packet1.stream_index == video_stream_index1) {
+                // the filtered output keeps the pts of input 1, time frames by it
+                easy_run_stats_packet_read(&run_stats, &packet1);
                 // Send the packet to the decoder.
-                if (avcodec_send_packet(dec_ctx1, &packet1) == 0) {
+                if (easy_send_packet(dec_ctx1, &packet1) == 0) {
                     // Receive all available frames.
-                    while (avcodec_receive_frame(dec_ctx1, frame1) == 0) {
+                    while (easy_receive_frame(dec_ctx1, frame1) == 0) {
+                        clock1 = frame1->pts * av_q2d(fmt_ctx1->streams[video_stream_index1]->time_base);
+                        easy_mem_budget_track_frame(&budget, frame1, EASY_MEM_FORCE);
+                        easy_run_stats_frame_decoded(&run_stats, frame1);
                         // Feed the frame into the filter graph for input 1.
-                        if (av_buffersrc_add_frame_flags(buffersrc_ctx1, frame1, AV_BUFFERSRC_FLAG_KEEP_REF) < 0) {
+                        EASY_TRACE_CALL("filter push",
+                                        ret = av_buffersrc_add_frame_flags(buffersrc_ctx1, frame1, AV_BUFFERSRC_FLAG_KEEP_REF));
+                        if (ret < 0) {
                             fprintf(stderr, "Error while feeding frame to filter graph (video1)\n");
                         }
                         av_frame_unref(frame1);
@@ -206,12 +235,19 @@ int main(int argc, char **argv)
         }
 
         // Process video2
-        if (!finished2 && av_read_frame(fmt_ctx2, &packet2) >= 0) {
+        if (throttle2) {
+            // wait for video1 to catch up
+        } else if (!finished2 && easy_read_frame(fmt_ctx2, &packet2) >= 0) {
             if (packet2.stream_index == video_stream_index2) {
-                if (avcodec_send_packet(dec_ctx2, &packet2) == 0) {
-                    while (avcodec_receive_frame(dec_ctx2, frame2) == 0) {
+                easy_run_stats_add_bytes(&run_stats, packet2.size);
+                if (easy_send_packet(dec_ctx2, &packet2) == 0) {
+                    while (easy_receive_frame(dec_ctx2, frame2) == 0) {
+                        clock2 = frame2->pts * av_q2d(fmt_ctx2->streams[video_stream_index2]->time_base);
+                        easy_mem_budget_track_frame(&budget, frame2, EASY_MEM_FORCE);
                         // Feed the frame into the filter graph for input 2.
-                        if (av_buffersrc_add_frame_flags(buffersrc_ctx2, frame2, AV_BUFFERSRC_FLAG_KEEP_REF) < 0) {
+                        EASY_TRACE_CALL("filter push",
+                                        ret = av_buffersrc_add_frame_flags(buffersrc_ctx2, frame2, AV_BUFFERSRC_FLAG_KEEP_REF));
+                        if (ret < 0) {
                             fprintf(stderr, "Error while feeding frame to filter graph (video2)\n");
                         }
                         av_frame_unref(frame2);
@@ -225,7 +261,7 @@ int main(int argc, char **argv)
         }
 
         // Try to pull a filtered frame from the sink.
-        int ret = av_buffersink_get_frame(buffersink_ctx, filt_frame);
+        EASY_TRACE_CALL("filter pull", ret = av_buffersink_get_frame(buffersink_ctx, filt_frame));
         if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
             // av_frame_free(&filt_frame);
             continue;
@@ -249,9 +285,23 @@ int main(int argc, char **argv)
                         filt_frame->data[2], filt_frame->linesize[2],
                         filt_frame->width, filt_frame->height, f);
         easy_render_yuv420p(&renderer, &texture, filt_frame, 25);
+        easy_run_stats_frame_done(&run_stats, filt_frame);
+        av_frame_unref(filt_frame);
         if ((ret = easy_sdl_event_in_loop(&event)) < 0) goto end;
 
     }
+    ret = 0;
+    av_log(NULL, AV_LOG_INFO, "Peak buffered frame memory: %lld bytes\n", (long long)budget.peak);
+
+    // export the run summary for scraping, next to the output file
+    easy_run_stats_finish(&run_stats);
+    char stats_name[1024];
+    snprintf(stats_name, sizeof(stats_name), "%s.prom", fileName);
+    FILE *fstats = fopen(stats_name, "w");
+    if (fstats) {
+        easy_run_stats_write_prometheus(&run_stats, fstats);
+        fclose(fstats);
+    }
 end:
     avfilter_graph_free(&filter_graph);
     avcodec_free_context(&dec_ctx1);
@@ -263,6 +313,9 @@ end:
     av_frame_free(&filt_frame);
     av_packet_free(&packet1);
     av_packet_free(&packet2);
+    easy_mem_budget_uninit(&budget);
+    if (easy_trace_enabled())
+        easy_trace_stop();
 
     if (ret < 0 && ret != AVERROR_EOF) {
         fprintf(stderr, "Error occurred: %s\n", av_err2str(ret));
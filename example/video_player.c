@@ -14,12 +14,24 @@
 
 #include "../include/easy_display.h"
 #include "../include/easy_media.h"
+#include "../include/easy_session.h"
+
+/* keep about a second of audio queued, the ring holds twice that */
+#define AUDIO_TARGET_BUFFER 1.0
+#define AUDIO_RING_SECONDS  2.0
+/* how long to sleep when no video frame is ready yet */
+#define POLL_INTERVAL_MS    5
 
 typedef struct VideoState{
-    AVCodecContext *avctx;
-    AVPacket       *pkt;
+    EasyAVSession  *session;
     AVFrame        *frame;
-    AVStream       *stream;
+    AVFrame        *audio_frame;
+    int             audio_pending; // audio_frame did not fit into the ring yet
+    int             audio_eof;
+
+    EasyAudioOutput audio;
+    int             has_audio;
+    EasyAVSync      sync;
 
     SDL_Texture    *texture;
 }VideoState;
@@ -27,57 +39,80 @@ typedef struct VideoState{
 static int w_width = 1920;
 static int w_height = 1080;
 
-static int decode(VideoState *is, SDL_Renderer *renderer)
+static double frame_pts(AVStream *st, AVFrame *frame)
 {
-    int ret = -1;
-
-    char buffer[1024];
-    //send packet to decoder
-    ret = avcodec_send_packet(is->avctx, is->pkt);
-    if(ret < 0){
-        av_log(NULL, AV_LOG_ERROR, "Failed to send frame to decoder!\n");
-        goto end;
-    }
+    int64_t pts = frame->best_effort_timestamp;
+    return pts == AV_NOPTS_VALUE ? NAN : pts * av_q2d(st->time_base);
+}
 
-    while (ret >= 0)
-    {
-        ret = avcodec_receive_frame(is->avctx, is->frame);
-        if(ret == AVERROR(EAGAIN) || ret == AVERROR_EOF){
-            ret = 0;
-            goto end;
-        }else if(ret < 0){
-            ret = -1;
-            goto end;
+/* move decoded audio into the output ring until enough is buffered, never
+ * blocks: the audio decoder may be behind the video one */
+static int fill_audio(VideoState *is)
+{
+    AVStream *st;
+    int ret;
+
+    if (!is->has_audio)
+        return 0;
+    st = is->session->fmt_ctx->streams[is->session->audio.stream_index];
+
+    while (!is->audio_eof &&
+           easy_audio_free_space(&is->audio) > AUDIO_RING_SECONDS - AUDIO_TARGET_BUFFER) {
+        if (!is->audio_pending) {
+            ret = easy_av_session_try_read(is->session, AVMEDIA_TYPE_AUDIO, is->audio_frame);
+            if (ret == AVERROR(EAGAIN))
+                break;
+            if (ret == AVERROR_EOF) {
+                is->audio_eof = 1;
+                break;
+            }
+            if (ret < 0)
+                return ret;
+            is->audio_pending = 1;
         }
 
-        int frameRate = is->stream->r_frame_rate.num/is->stream->r_frame_rate.den;
-        easy_render_yuv420p(renderer, is->texture, is->frame, frameRate);
+        ret = easy_audio_queue_frame(&is->audio, is->audio_frame, frame_pts(st, is->audio_frame));
+        if (ret == AVERROR(EAGAIN))
+            break;
+        av_frame_unref(is->audio_frame);
+        is->audio_pending = 0;
+        if (ret < 0)
+            return ret;
     }
-    
+    return 0;
+}
 
-end:
-    return ret;
+/* sleep until the frame is due, topping up audio meanwhile */
+static int wait_frame(VideoState *is, Uint32 delay_ms)
+{
+    Uint32 deadline = SDL_GetTicks() + delay_ms;
+    int ret;
+
+    for (;;) {
+        Uint32 now = SDL_GetTicks();
+        if ((ret = fill_audio(is)) < 0)
+            return ret;
+        if ((Sint32)(deadline - now) <= 0)
+            return 0;
+        SDL_Delay(deadline - now < 10 ? deadline - now : 10);
+    }
 }
 
 int main(int argc, char *argv[])
 {
 
     int ret = -1;
-    int idx = -1;
-    AVFormatContext *fmtCtx = NULL;
+    EasyAVSession *session = NULL;
     AVStream *inStream = NULL;
-    const AVCodec *decodec = NULL;
     AVCodecContext *ctx = NULL;
-
-    Uint32 pixformat = 0;
-
-    int video_height = 0;
-    int video_width = 0;
-
-    AVPacket *pkt = NULL;
-    AVFrame *frame = NULL;
+    EasyAudioStats stats;
+    double duration = 0.04;
 
     VideoState *is = NULL; 
+    SDL_Window *win = NULL;
+    SDL_Renderer *renderer = NULL;
+    SDL_Texture *texture = NULL;
+    SDL_Event event;
     
     //deal with arguments
     char *src;
@@ -97,67 +132,115 @@ int main(int argc, char *argv[])
         goto end;
     }
 
-    easy_open_video(src, &fmtCtx, &ctx, &idx);
-
-    //create texture for render 
-    video_width = ctx->width;
-    video_height = ctx->height;
+    //demux once, decode audio and video on their own threads
+    if ((ret = easy_av_session_open(&session, src, NULL)) < 0)
+        goto end;
+    if (!session->video.dec_ctx) {
+        av_log(NULL, AV_LOG_ERROR, "No video stream to play!\n");
+        ret = AVERROR_STREAM_NOT_FOUND;
+        goto end;
+    }
+    ctx = session->video.dec_ctx;
+    inStream = session->fmt_ctx->streams[session->video.stream_index];
+    if (inStream->avg_frame_rate.num && inStream->avg_frame_rate.den)
+        duration = av_q2d(av_inv_q(inStream->avg_frame_rate));
 
     //init SDL
-    SDL_Window *win = NULL;
-    SDL_Renderer *renderer = NULL;
     easy_init_sdl_for_render(&win, &renderer, w_width, w_height);
-    SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_IYUV, SDL_TEXTUREACCESS_STREAMING, video_width, video_height);
-    SDL_Event event;
-
-    pkt = av_packet_alloc();
-    frame = av_frame_alloc();
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_IYUV, SDL_TEXTUREACCESS_STREAMING, ctx->width, ctx->height);
+
+    //audio is the master clock, without it video is paced by its frame rate
+    if (session->audio.dec_ctx) {
+        is->has_audio = !easy_init_sdl_audio(&is->audio, session->audio.dec_ctx->sample_rate,
+                                             easy_codec_channels(session->audio.dec_ctx), AUDIO_RING_SECONDS);
+        if (!is->has_audio) {
+            //nobody would read the audio frames and the demuxer would stall on them
+            EasyAVSessionOptions opts = { .disable_audio = 1 };
+            easy_av_session_close(&session);
+            if ((ret = easy_av_session_open(&session, src, &opts)) < 0)
+                goto end;
+            ctx = session->video.dec_ctx;
+            inStream = session->fmt_ctx->streams[session->video.stream_index];
+        }
+    }
 
-    is->stream = fmtCtx->streams[idx];
+    is->session = session;
     is->texture = texture;
-    is->avctx = ctx;
-    is->pkt = pkt;
-    is->frame = frame;
-    
-    //decode
-    while(av_read_frame(fmtCtx, pkt) >= 0){
-        if(pkt->stream_index == idx ){
-            //render
-            decode(is, renderer);
+    is->frame = av_frame_alloc();
+    is->audio_frame = av_frame_alloc();
+    if (!is->frame || !is->audio_frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    if ((ret = easy_av_session_start(session)) < 0)
+        goto end;
+
+    //present video frames against the audio clock, both queues are polled so
+    //audio keeps flowing however far it runs ahead of or behind video
+    for (;;) {
+        Uint32 delay_ms;
+
+        if ((ret = fill_audio(is)) < 0)
+            goto end;
+
+        ret = easy_av_session_try_read(session, AVMEDIA_TYPE_VIDEO, is->frame);
+        if (ret == AVERROR(EAGAIN)) {
+            SDL_Delay(POLL_INTERVAL_MS);
+        } else if (ret < 0) {
+            break;
+        } else {
+            if (easy_av_sync_video(&is->sync, is->has_audio ? &is->audio : NULL,
+                                   frame_pts(inStream, is->frame), duration, &delay_ms) == EASY_SYNC_SHOW) {
+                if ((ret = wait_frame(is, delay_ms)) < 0)
+                    goto end;
+                easy_render_yuv420p(&renderer, &texture, is->frame, 0);
+            }
+            av_frame_unref(is->frame);
         }
+
         //deal with SDL event
-        if ((ret = easy_sdl_event_in_loop(&event)) < 0) goto end;
+        if ((ret = easy_sdl_event_in_loop(&event)) < 0) goto quit;
+    }
+    if (ret != AVERROR_EOF)
+        goto end;
 
-        av_packet_unref(pkt);
-    
+    //video is done, let the rest of the audio play out before quitting
+    while (is->has_audio && (!is->audio_eof || is->audio_pending || easy_audio_ring_fill(&is->audio) > 0)) {
+        if ((ret = fill_audio(is)) < 0)
+            goto end;
+        SDL_Delay(POLL_INTERVAL_MS);
+        if ((ret = easy_sdl_event_in_loop(&event)) < 0) goto quit;
     }
-    is->pkt = NULL;
-    decode(is, renderer);
+    if (is->has_audio)
+        SDL_Delay((Uint32)(easy_audio_device_delay(&is->audio) * 1000));
 
 quit:
+    if (is->has_audio) {
+        easy_audio_get_stats(&is->audio, &stats);
+        av_log(NULL, AV_LOG_INFO, "A/V sync: %"PRId64" frames dropped, %"PRId64" held, "
+               "%d audio underruns, %.0f ms audio latency\n",
+               is->sync.dropped, is->sync.repeated, stats.underruns, stats.latency * 1000);
+    }
     ret = 0;
 end:
-    if(frame){
-        av_frame_free(&frame);
-    }
-    if (pkt){
-        av_packet_free(&pkt);
-    }
-    if(ctx){
-        avcodec_free_context(&ctx);
+    if (is) {
+        if (is->has_audio)
+            easy_close_sdl_audio(&is->audio);
+        av_frame_free(&is->frame);
+        av_frame_free(&is->audio_frame);
+        av_free(is);
     }
-    if(fmtCtx){
-        avformat_close_input(&fmtCtx);
-    }
-    if(win){
-        SDL_DestroyWindow(win);
+    easy_av_session_close(&session);
+    if(texture){
+        SDL_DestroyTexture(texture);
     }
     if(renderer){
         SDL_DestroyRenderer(renderer);
     }
-    if(texture){
-        SDL_DestroyTexture(texture);
+    if(win){
+        SDL_DestroyWindow(win);
     }
     SDL_Quit();    
     return ret;
-}
\ No newline at end of file
+}
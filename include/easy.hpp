@@ -0,0 +1,311 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_HPP__
+#define __EASY_HPP__
+
+/*
+ * C++ layer over the C helpers: move-only owning handles and a lazy decode
+ * range.
+ *
+ *     for (AVFrame &frame : easy::decode("in.mp4"))
+ *         process(frame);
+ *
+ * Everything is freed on scope exit, errors are thrown as easy::Error. Include
+ * this header before any other easy_*.h or FFmpeg header, it declares them
+ * with C linkage.
+ */
+
+/* the C++ standard headers the C ones would pull in, they must not end up inside extern "C" */
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <pthread.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/error.h>
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+
+#include "easy_common.h"
+#include "easy_decoder_pool.h"
+#include "easy_media.h"
+#include "easy_trace.h"
+}
+
+namespace easy {
+
+/**
+ * An FFmpeg error, code() is the negative AVERROR code.
+ */
+class Error : public std::runtime_error {
+public:
+    Error(int code, const std::string &what) : std::runtime_error(what + ": " + message(code)), code_(code) {}
+
+    int code() const noexcept { return code_; }
+
+    static std::string message(int code)
+    {
+        char buf[128];
+        av_strerror(code, buf, sizeof(buf));
+        return buf;
+    }
+
+private:
+    int code_;
+};
+
+/* throw for negative AVERROR codes, pass anything else through */
+inline int check(int ret, const char *what)
+{
+    if (ret < 0)
+        throw Error(ret, what);
+    return ret;
+}
+
+/**
+ * Owns one FFmpeg object and frees it with the matching FFmpeg function.
+ *
+ * Move-only: copying a frame or a context by accident is what this layer is
+ * here to prevent, use clone() for a new reference to a frame.
+ */
+template <typename T, void (*Free)(T **)>
+class Handle {
+public:
+    Handle() noexcept = default;
+    explicit Handle(T *p) noexcept : p_(p) {}
+    Handle(Handle &&other) noexcept : p_(other.release()) {}
+    Handle &operator=(Handle &&other) noexcept
+    {
+        reset(other.release());
+        return *this;
+    }
+    Handle(const Handle &) = delete;
+    Handle &operator=(const Handle &) = delete;
+    ~Handle() { reset(); }
+
+    T *get() const noexcept { return p_; }
+    T *operator->() const noexcept { return p_; }
+    T &operator*() const noexcept { return *p_; }
+    explicit operator bool() const noexcept { return p_ != nullptr; }
+
+    /** Give up ownership without freeing. */
+    T *release() noexcept
+    {
+        T *p = p_;
+        p_ = nullptr;
+        return p;
+    }
+
+    /** Free the owned object and take p instead. */
+    void reset(T *p = nullptr) noexcept
+    {
+        if (p_)
+            Free(&p_);
+        p_ = p;
+    }
+
+    /** Free the owned object and return its slot, for C functions with a T ** output. */
+    T **put() noexcept
+    {
+        reset();
+        return &p_;
+    }
+
+private:
+    T *p_ = nullptr;
+};
+
+inline void free_sws(SwsContext **sws)
+{
+    sws_freeContext(*sws);
+    *sws = nullptr;
+}
+
+using FormatContext = Handle<AVFormatContext, avformat_close_input>;
+using CodecContext  = Handle<AVCodecContext, avcodec_free_context>;
+using Packet        = Handle<AVPacket, av_packet_free>;
+using Frame         = Handle<AVFrame, av_frame_free>;
+using ScaleContext  = Handle<SwsContext, free_sws>;
+
+/** Allocate an empty packet, throws std::bad_alloc. */
+inline Packet make_packet()
+{
+    Packet pkt(av_packet_alloc());
+    if (!pkt)
+        throw std::bad_alloc();
+    return pkt;
+}
+
+/** Allocate an empty frame, throws std::bad_alloc. */
+inline Frame make_frame()
+{
+    Frame frame(av_frame_alloc());
+    if (!frame)
+        throw std::bad_alloc();
+    return frame;
+}
+
+/** Take a new reference to the data of a frame, no pixels are copied. */
+inline Frame clone(const AVFrame &frame)
+{
+    Frame ref(av_frame_clone(&frame));
+    if (!ref)
+        throw std::bad_alloc();
+    return ref;
+}
+
+/**
+ * The frames of the best video stream of a file, decoded lazily while
+ * iterating.
+ *
+ * One packet and one frame are allocated up front and reused: each step
+ * hands out the same AVFrame, refilled by the decoder. Its data stays valid
+ * until the next step, keep it longer with clone().
+ */
+class Decoder {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type        = AVFrame;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = AVFrame *;
+        using reference         = AVFrame &;
+
+        iterator() noexcept = default;
+        explicit iterator(Decoder *dec) : dec_(dec) { ++*this; }
+
+        reference operator*() const noexcept { return *dec_->frame_; }
+        pointer operator->() const noexcept { return dec_->frame_.get(); }
+        iterator &operator++()
+        {
+            if (!dec_->next())
+                dec_ = nullptr;
+            return *this;
+        }
+        bool operator==(const iterator &other) const noexcept { return dec_ == other.dec_; }
+        bool operator!=(const iterator &other) const noexcept { return dec_ != other.dec_; }
+
+    private:
+        Decoder *dec_ = nullptr;
+    };
+
+    /**
+     * Open a file and its decoder, see easy_open_video2() for the options.
+     */
+    explicit Decoder(const std::string &filename, const EasyVideoOptions &opts = EasyVideoOptions())
+        : pkt_(make_packet()), frame_(make_frame()), pool_(opts.decoder_pool)
+    {
+        AVCodecContext *dec = nullptr;
+        EasyVideoOptions o = opts;
+        int ret = easy_open_video2(filename.c_str(), fmt_.put(), &dec, &stream_index_, &o);
+
+        /* also when opening failed, the context may have been allocated */
+        dec_.reset(dec);
+        check(ret, filename.c_str());
+    }
+
+    Decoder(Decoder &&) noexcept = default;
+    Decoder &operator=(Decoder &&) = delete;
+    Decoder(const Decoder &) = delete;
+    Decoder &operator=(const Decoder &) = delete;
+
+    ~Decoder()
+    {
+        /* a pooled decoder goes back to the pool instead of being freed */
+        if (pool_ && dec_) {
+            AVCodecContext *dec = dec_.release();
+            easy_decoder_pool_release(pool_, &dec);
+        }
+    }
+
+    /** Start decoding, a Decoder can be iterated once. */
+    iterator begin() { return iterator(this); }
+    iterator end() noexcept { return iterator(); }
+
+    AVFormatContext *format_context() const noexcept { return fmt_.get(); }
+    AVCodecContext *codec_context() const noexcept { return dec_.get(); }
+    AVStream *stream() const noexcept { return fmt_->streams[stream_index_]; }
+    int stream_index() const noexcept { return stream_index_; }
+
+private:
+    /* decode the next frame into frame_, false at the end of the stream */
+    bool next()
+    {
+        for (;;) {
+            int ret = easy_receive_frame(dec_.get(), frame_.get());
+            if (ret >= 0)
+                return true;
+            if (ret == AVERROR_EOF)
+                return false;
+            if (ret != AVERROR(EAGAIN))
+                check(ret, "receive_frame");
+
+            /* the decoder wants input, feed it the next packet of our stream */
+            while (!draining_) {
+                ret = easy_read_frame(fmt_.get(), pkt_.get());
+                if (ret == AVERROR_EOF) {
+                    check(easy_send_packet(dec_.get(), nullptr), "send_packet");
+                    draining_ = true;
+                    break;
+                }
+                check(ret, "read_frame");
+                if (pkt_->stream_index != stream_index_) {
+                    av_packet_unref(pkt_.get());
+                    continue;
+                }
+                ret = easy_send_packet(dec_.get(), pkt_.get());
+                av_packet_unref(pkt_.get());
+                /* a corrupt packet only loses its own frames */
+                if (ret < 0 && ret != AVERROR_INVALIDDATA)
+                    check(ret, "send_packet");
+                break;
+            }
+        }
+    }
+
+    FormatContext    fmt_;
+    CodecContext     dec_;
+    Packet           pkt_;
+    Frame            frame_;
+    EasyDecoderPool *pool_         = nullptr;
+    int              stream_index_ = -1;
+    bool             draining_     = false;
+};
+
+/**
+ * Decode the best video stream of a file lazily:
+ *
+ *     for (AVFrame &frame : easy::decode(path, opts)) { ... }
+ */
+inline Decoder decode(const std::string &filename, const EasyVideoOptions &opts = EasyVideoOptions())
+{
+    return Decoder(filename, opts);
+}
+
+} // namespace easy
+
+#endif // __EASY_HPP__
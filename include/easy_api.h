@@ -15,9 +15,24 @@
 #ifndef __EASY_API_H__
 #define __EASY_API_H__
 
+#include "easy_audio.h"
+#include "easy_color.h"
 #include "easy_common.h"
+#include "easy_compositor.h"
+#include "easy_decoder_pool.h"
 #include "easy_display.h"
+#include "easy_frame_pool.h"
+#include "easy_framestats.h"
 #include "easy_media.h"
+#include "easy_memory.h"
+#include "easy_mosaic.h"
+#include "easy_phash.h"
+#include "easy_sampler.h"
+#include "easy_scene.h"
+#include "easy_session.h"
+#include "easy_stats.h"
+#include "easy_thread.h"
+#include "easy_trace.h"
 #include "easy_utils.h"
 
 #endif // __EASY_API_H__
\ No newline at end of file
@@ -0,0 +1,651 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_AUDIO_H__
+#define __EASY_AUDIO_H__
+
+#include "easy_common.h"
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+#include <libavutil/mem.h>
+#include <libavutil/samplefmt.h>
+#include <libavutil/version.h>
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define EASY_WAVEFORM_MAX_LEVELS    32
+#define EASY_WAVEFORM_MAGIC         "EWAV"
+/* BS.1770 gating: 400 ms blocks made of 4 steps of 100 ms */
+#define EASY_LOUDNESS_STEPS         4
+#define EASY_LOUDNESS_ABSOLUTE_GATE -70.0
+#define EASY_LOUDNESS_RELATIVE_GATE -10.0
+
+/**
+ * Get the number of channels of a decoded audio frame.
+ */
+static inline int easy_frame_channels(const AVFrame *frame)
+{
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 28, 100)
+    return frame->ch_layout.nb_channels;
+#else
+    return frame->channels;
+#endif
+}
+
+/**
+ * Get the number of channels an audio decoder outputs.
+ */
+static inline int easy_codec_channels(const AVCodecContext *avctx)
+{
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 28, 100)
+    return avctx->ch_layout.nb_channels;
+#else
+    return avctx->channels;
+#endif
+}
+
+/**
+ * Convert a decoded audio frame to interleaved float samples.
+ *
+ * Each sample format gets its own tight loop, so the common cases (fltp,
+ * s16, s16p) convert without per-sample branching.
+ *
+ * @param frame The decoded audio frame, packed or planar u8/s16/s32/flt/dbl.
+ * @param dst The destination, at least nb_samples * channels floats.
+ *
+ * @return The number of floats written, AVERROR(EINVAL) for unsupported formats.
+ */
+static inline int easy_audio_to_float(const AVFrame *frame, float *dst)
+{
+    enum AVSampleFormat fmt = (enum AVSampleFormat)frame->format;
+    int channels = easy_frame_channels(frame);
+    int planar = av_sample_fmt_is_planar(fmt);
+    int n = frame->nb_samples;
+
+    for (int ch = 0; ch < (planar ? channels : 1); ch++) {
+        const uint8_t *src = frame->extended_data[ch];
+        /* planar input is scattered into every channels-th float */
+        int count = planar ? n : n * channels;
+        int step = planar ? channels : 1;
+        float *out = dst + (planar ? ch : 0);
+
+        switch (av_get_packed_sample_fmt(fmt)) {
+        case AV_SAMPLE_FMT_U8:
+            for (int i = 0; i < count; i++)
+                out[i * step] = (src[i] - 128) * (1.0f / 128);
+            break;
+        case AV_SAMPLE_FMT_S16:
+            for (int i = 0; i < count; i++)
+                out[i * step] = ((const int16_t *)src)[i] * (1.0f / 32768);
+            break;
+        case AV_SAMPLE_FMT_S32:
+            for (int i = 0; i < count; i++)
+                out[i * step] = ((const int32_t *)src)[i] * (1.0f / 2147483648.0f);
+            break;
+        case AV_SAMPLE_FMT_FLT:
+            for (int i = 0; i < count; i++)
+                out[i * step] = ((const float *)src)[i];
+            break;
+        case AV_SAMPLE_FMT_DBL:
+            for (int i = 0; i < count; i++)
+                out[i * step] = (float)((const double *)src)[i];
+            break;
+        default:
+            av_log(NULL, AV_LOG_ERROR, "Unsupported sample format %s\n", av_get_sample_fmt_name(fmt));
+            return AVERROR(EINVAL);
+        }
+    }
+    return n * channels;
+}
+
+/**
+ * Convert one channel of a decoded audio frame to float samples.
+ *
+ * @param frame The decoded audio frame, packed or planar u8/s16/s32/flt/dbl.
+ * @param ch The channel.
+ * @param dst The destination, at least nb_samples floats.
+ *
+ * @return 0 on success, AVERROR(EINVAL) for unsupported formats.
+ */
+static inline int easy_audio_channel_to_float(const AVFrame *frame, int ch, float *dst)
+{
+    enum AVSampleFormat fmt = (enum AVSampleFormat)frame->format;
+    int planar = av_sample_fmt_is_planar(fmt);
+    /* packed input is read every channels-th sample */
+    int step = planar ? 1 : easy_frame_channels(frame);
+    const uint8_t *src = frame->extended_data[planar ? ch : 0];
+    int first = planar ? 0 : ch;
+    int n = frame->nb_samples;
+
+    switch (av_get_packed_sample_fmt(fmt)) {
+    case AV_SAMPLE_FMT_U8:
+        for (int i = 0; i < n; i++)
+            dst[i] = (src[first + i * step] - 128) * (1.0f / 128);
+        break;
+    case AV_SAMPLE_FMT_S16:
+        for (int i = 0; i < n; i++)
+            dst[i] = ((const int16_t *)src)[first + i * step] * (1.0f / 32768);
+        break;
+    case AV_SAMPLE_FMT_S32:
+        for (int i = 0; i < n; i++)
+            dst[i] = ((const int32_t *)src)[first + i * step] * (1.0f / 2147483648.0f);
+        break;
+    case AV_SAMPLE_FMT_FLT:
+        for (int i = 0; i < n; i++)
+            dst[i] = ((const float *)src)[first + i * step];
+        break;
+    case AV_SAMPLE_FMT_DBL:
+        for (int i = 0; i < n; i++)
+            dst[i] = (float)((const double *)src)[first + i * step];
+        break;
+    default:
+        av_log(NULL, AV_LOG_ERROR, "Unsupported sample format %s\n", av_get_sample_fmt_name(fmt));
+        return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
+/**
+ * Minimum, maximum and sum of squares of a run of samples.
+ */
+static inline void easy_audio_block_stats(const float *x, int n, float *min, float *max, double *sumsq)
+{
+    float lo = *min, hi = *max, sq = 0;
+    int i = 0;
+
+#if defined(__SSE2__)
+    __m128 vlo = _mm_set1_ps(lo), vhi = _mm_set1_ps(hi), vsq = _mm_setzero_ps();
+    float out[4];
+
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(x + i);
+        vlo = _mm_min_ps(vlo, v);
+        vhi = _mm_max_ps(vhi, v);
+        vsq = _mm_add_ps(vsq, _mm_mul_ps(v, v));
+    }
+    _mm_storeu_ps(out, vlo);
+    lo = FFMIN(FFMIN(out[0], out[1]), FFMIN(out[2], out[3]));
+    _mm_storeu_ps(out, vhi);
+    hi = FFMAX(FFMAX(out[0], out[1]), FFMAX(out[2], out[3]));
+    _mm_storeu_ps(out, vsq);
+    sq = (out[0] + out[1]) + (out[2] + out[3]);
+#endif
+    for (; i < n; i++) {
+        lo  = FFMIN(lo, x[i]);
+        hi  = FFMAX(hi, x[i]);
+        sq += x[i] * x[i];
+    }
+    *min = lo;
+    *max = hi;
+    *sumsq += sq;
+}
+
+/**
+ * One bin of a waveform: the sample range and RMS of all channels over the
+ * samples it covers, as 16-bit fractions of full scale.
+ */
+typedef struct EasyWaveformBin {
+    int16_t  min;
+    int16_t  max;
+    uint16_t rms;
+} EasyWaveformBin;
+
+/**
+ * The bins of one zoom level, level n has 2^n windows per bin.
+ */
+typedef struct EasyWaveformLevel {
+    EasyWaveformBin *bins;
+    int64_t          nb_bins;
+    int64_t          capacity;
+} EasyWaveformLevel;
+
+/**
+ * Whole-stream results of an EasyAudioAnalyzer.
+ */
+typedef struct EasyAudioSummary {
+    double  peak_dbfs;          ///< highest absolute sample
+    double  rms_dbfs;
+    double  integrated_lufs;    ///< BS.1770 gated loudness, -HUGE_VAL for silence
+    double  max_momentary_lufs; ///< loudest 400 ms block
+    int64_t nb_samples;         ///< per channel
+} EasyAudioSummary;
+
+/**
+ * Streaming peak, RMS, loudness and waveform analysis of decoded audio.
+ *
+ * Frames are analyzed as they are decoded, one channel at a time through a
+ * frame-sized float buffer, so memory does not grow with the duration except
+ * for the waveform (6 bytes per window, twice that with every zoom level)
+ * and 8 bytes per 100 ms for loudness gating.
+ *
+ * Loudness follows BS.1770: a K-weighting filter per channel, 400 ms blocks
+ * with 75% overlap and the -70 LUFS absolute and -10 LU relative gates. All
+ * channels are weighted 1.0.
+ */
+typedef struct EasyAudioAnalyzer {
+    int     sample_rate;
+    int     channels;
+    int     window;           ///< samples per channel in each level 0 waveform bin
+
+    /* the waveform window being filled */
+    float   win_min, win_max;
+    double  win_sumsq;
+    int     win_fill;
+    EasyWaveformLevel levels[EASY_WAVEFORM_MAX_LEVELS];
+    int     nb_levels;
+
+    /* K-weighting, two biquads per channel, and the 100 ms step being filled */
+    double  kb[2][3], ka[2][3];
+    double *kstate;           ///< 4 values per channel and biquad
+    double  step_sum;
+    int     step_fill;
+    int     step_size;
+    double *steps;            ///< mean square of every 100 ms step
+    int64_t nb_steps, steps_capacity;
+
+    /* whole stream */
+    float   peak;
+    double  sumsq;
+    int64_t nb_samples;
+
+    float  *scratch;          ///< one channel of the current frame
+    int     scratch_size;
+} EasyAudioAnalyzer;
+
+/**
+ * Free the buffers of an analyzer.
+ */
+static inline void easy_audio_analyzer_uninit(EasyAudioAnalyzer *a)
+{
+    for (int i = 0; i < EASY_WAVEFORM_MAX_LEVELS; i++)
+        av_freep(&a->levels[i].bins);
+    av_freep(&a->kstate);
+    av_freep(&a->steps);
+    av_freep(&a->scratch);
+}
+
+/**
+ * Initialize an analyzer.
+ *
+ * @param a The analyzer.
+ * @param sample_rate The sample rate of the frames.
+ * @param channels The number of channels of the frames.
+ * @param window The samples per level 0 waveform bin, e.g. 256.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_audio_analyzer_init(EasyAudioAnalyzer *a, int sample_rate, int channels, int window)
+{
+    double f0, g, q, k, vh, vb, a0;
+
+    memset(a, 0, sizeof(*a));
+    if (sample_rate <= 0 || channels <= 0 || window <= 0)
+        return AVERROR(EINVAL);
+    a->sample_rate = sample_rate;
+    a->channels    = channels;
+    a->window      = window;
+    a->step_size   = FFMAX(sample_rate / 10, 1);
+    a->win_min     = 1.0f;
+    a->win_max     = -1.0f;
+    a->nb_levels   = 1;
+
+    if (!(a->kstate = (double *)av_calloc(channels * 4, sizeof(*a->kstate))))
+        return AVERROR(ENOMEM);
+
+    /* the BS.1770 high shelf and high pass, bilinear transform for this rate */
+    f0 = 1681.974450955533;
+    g  = 3.999843853973347;
+    q  = 0.7071752369554196;
+    k  = tan(M_PI * f0 / sample_rate);
+    vh = pow(10.0, g / 20.0);
+    vb = pow(vh, 0.4996667741545416);
+    a0 = 1.0 + k / q + k * k;
+    a->kb[0][0] = (vh + vb * k / q + k * k) / a0;
+    a->kb[0][1] = 2.0 * (k * k - vh) / a0;
+    a->kb[0][2] = (vh - vb * k / q + k * k) / a0;
+    a->ka[0][1] = 2.0 * (k * k - 1.0) / a0;
+    a->ka[0][2] = (1.0 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q  = 0.5003270373238773;
+    k  = tan(M_PI * f0 / sample_rate);
+    a0 = 1.0 + k / q + k * k;
+    a->kb[1][0] = 1.0;
+    a->kb[1][1] = -2.0;
+    a->kb[1][2] = 1.0;
+    a->ka[1][1] = 2.0 * (k * k - 1.0) / a0;
+    a->ka[1][2] = (1.0 - k / q + k * k) / a0;
+    return 0;
+}
+
+static inline int easy_waveform_level_append(EasyWaveformLevel *level, EasyWaveformBin bin)
+{
+    if (level->nb_bins == level->capacity) {
+        int64_t capacity = FFMAX(256, level->capacity * 2);
+        EasyWaveformBin *bins = (EasyWaveformBin *)av_realloc_array(level->bins, capacity, sizeof(*bins));
+        if (!bins)
+            return AVERROR(ENOMEM);
+        level->bins     = bins;
+        level->capacity = capacity;
+    }
+    level->bins[level->nb_bins++] = bin;
+    return 0;
+}
+
+/* add a level 0 bin and merge every completed pair into the level above */
+static inline int easy_audio_analyzer_push_bin(EasyAudioAnalyzer *a, EasyWaveformBin bin)
+{
+    int ret;
+
+    for (int l = 0; l < EASY_WAVEFORM_MAX_LEVELS; l++) {
+        EasyWaveformLevel *level = &a->levels[l];
+        const EasyWaveformBin *pair;
+        double r0, r1;
+
+        if ((ret = easy_waveform_level_append(level, bin)) < 0)
+            return ret;
+        a->nb_levels = FFMAX(a->nb_levels, l + 1);
+        if (level->nb_bins & 1 || l + 1 == EASY_WAVEFORM_MAX_LEVELS)
+            break;
+        pair = &level->bins[level->nb_bins - 2];
+        r0 = pair[0].rms;
+        r1 = pair[1].rms;
+        bin.min = FFMIN(pair[0].min, pair[1].min);
+        bin.max = FFMAX(pair[0].max, pair[1].max);
+        bin.rms = (uint16_t)lrint(sqrt((r0 * r0 + r1 * r1) / 2));
+    }
+    return 0;
+}
+
+static inline int easy_audio_analyzer_close_window(EasyAudioAnalyzer *a)
+{
+    EasyWaveformBin bin;
+    double rms = sqrt(a->win_sumsq / ((double)a->win_fill * a->channels));
+
+    bin.min = (int16_t)lrintf(av_clipf(a->win_min, -1.0f, 1.0f) * 32767);
+    bin.max = (int16_t)lrintf(av_clipf(a->win_max, -1.0f, 1.0f) * 32767);
+    bin.rms = (uint16_t)lrint(FFMIN(rms, 1.0) * 65535);
+    a->win_min   = 1.0f;
+    a->win_max   = -1.0f;
+    a->win_sumsq = 0;
+    a->win_fill  = 0;
+    return easy_audio_analyzer_push_bin(a, bin);
+}
+
+static inline int easy_audio_analyzer_close_step(EasyAudioAnalyzer *a)
+{
+    if (a->nb_steps == a->steps_capacity) {
+        int64_t capacity = FFMAX(1024, a->steps_capacity * 2);
+        double *steps = (double *)av_realloc_array(a->steps, capacity, sizeof(*steps));
+        if (!steps)
+            return AVERROR(ENOMEM);
+        a->steps          = steps;
+        a->steps_capacity = capacity;
+    }
+    a->steps[a->nb_steps++] = a->step_sum / a->step_fill;
+    a->step_sum  = 0;
+    a->step_fill = 0;
+    return 0;
+}
+
+/* K-weight a run of samples of one channel, return the sum of squares */
+static inline double easy_audio_k_weight(const EasyAudioAnalyzer *a, double *st, const float *x, int n)
+{
+    /* locals, the state stores could alias the coefficients otherwise */
+    const double b0 = a->kb[0][0], b1 = a->kb[0][1], b2 = a->kb[0][2];
+    const double a1 = a->ka[0][1], a2 = a->ka[0][2], c1 = a->ka[1][1], c2 = a->ka[1][2];
+    double s0 = st[0], s1 = st[1], s2 = st[2], s3 = st[3], sum = 0;
+
+    for (int i = 0; i < n; i++) {
+        double v = x[i], y;
+        y   = b0 * v + s0;
+        s0  = b1 * v - a1 * y + s1;
+        s1  = b2 * v - a2 * y;
+        v   = y;
+        y   = v + s2; // the high pass numerator is { 1, -2, 1 }
+        s2  = -2.0 * v - c1 * y + s3;
+        s3  = v - c2 * y;
+        sum += y * y;
+    }
+    st[0] = s0;
+    st[1] = s1;
+    st[2] = s2;
+    st[3] = s3;
+    return sum;
+}
+
+/*
+ * easy_audio_k_weight() on two channels at once: each filter is a serial
+ * chain in time, running two side by side hides half of its latency.
+ */
+static inline double easy_audio_k_weight2(const EasyAudioAnalyzer *a, double *st, const float *x0, const float *x1,
+                                          int n)
+{
+    const double b0 = a->kb[0][0], b1 = a->kb[0][1], b2 = a->kb[0][2];
+    const double a1 = a->ka[0][1], a2 = a->ka[0][2], c1 = a->ka[1][1], c2 = a->ka[1][2];
+    double s[8], sum0 = 0, sum1 = 0;
+
+    memcpy(s, st, sizeof(s));
+    for (int i = 0; i < n; i++) {
+        double v0 = x0[i], v1 = x1[i], y0, y1;
+        y0   = b0 * v0 + s[0];
+        y1   = b0 * v1 + s[4];
+        s[0] = b1 * v0 - a1 * y0 + s[1];
+        s[4] = b1 * v1 - a1 * y1 + s[5];
+        s[1] = b2 * v0 - a2 * y0;
+        s[5] = b2 * v1 - a2 * y1;
+        v0   = y0;
+        v1   = y1;
+        y0   = v0 + s[2];
+        y1   = v1 + s[6];
+        s[2] = -2.0 * v0 - c1 * y0 + s[3];
+        s[6] = -2.0 * v1 - c1 * y1 + s[7];
+        s[3] = v0 - c2 * y0;
+        s[7] = v1 - c2 * y1;
+        sum0 += y0 * y0;
+        sum1 += y1 * y1;
+    }
+    memcpy(st, s, sizeof(s));
+    return sum0 + sum1;
+}
+
+/**
+ * Analyze one decoded frame.
+ *
+ * @param a The analyzer.
+ * @param frame A frame with the channels given at init, any packed or planar
+ *              u8/s16/s32/flt/dbl format.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_audio_analyzer_add_frame(EasyAudioAnalyzer *a, const AVFrame *frame)
+{
+    int n = frame->nb_samples, ret;
+
+    if (easy_frame_channels(frame) != a->channels)
+        return AVERROR(EINVAL);
+    if (a->scratch_size < n * a->channels) {
+        av_freep(&a->scratch);
+        if (!(a->scratch = (float *)av_malloc_array(n, a->channels * sizeof(*a->scratch))))
+            return AVERROR(ENOMEM);
+        a->scratch_size = n * a->channels;
+    }
+    /* planar float per channel, so the kernels below run on contiguous samples */
+    for (int ch = 0; ch < a->channels; ch++)
+        if ((ret = easy_audio_channel_to_float(frame, ch, a->scratch + (size_t)ch * n)) < 0)
+            return ret;
+
+    for (int i = 0; i < n;) {
+        int len = FFMIN(n - i, a->window - a->win_fill);
+        for (int ch = 0; ch < a->channels; ch++)
+            easy_audio_block_stats(a->scratch + (size_t)ch * n + i, len, &a->win_min, &a->win_max, &a->win_sumsq);
+        a->win_fill += len;
+        i += len;
+        if (a->win_fill == a->window) {
+            a->sumsq += a->win_sumsq;
+            a->peak   = FFMAX(a->peak, FFMAX(a->win_max, -a->win_min));
+            if ((ret = easy_audio_analyzer_close_window(a)) < 0)
+                return ret;
+        }
+    }
+
+    for (int i = 0; i < n;) {
+        int len = FFMIN(n - i, a->step_size - a->step_fill);
+        int ch = 0;
+        for (; ch + 2 <= a->channels; ch += 2)
+            a->step_sum += easy_audio_k_weight2(a, &a->kstate[ch * 4], a->scratch + (size_t)ch * n + i,
+                                                a->scratch + (size_t)(ch + 1) * n + i, len);
+        for (; ch < a->channels; ch++)
+            a->step_sum += easy_audio_k_weight(a, &a->kstate[ch * 4], a->scratch + (size_t)ch * n + i, len);
+        a->step_fill += len;
+        i += len;
+        if (a->step_fill == a->step_size && (ret = easy_audio_analyzer_close_step(a)) < 0)
+            return ret;
+    }
+
+    a->nb_samples += n;
+    return 0;
+}
+
+/**
+ * Close the last partial waveform window, call it once after the last frame.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_audio_analyzer_finish(EasyAudioAnalyzer *a)
+{
+    if (!a->win_fill)
+        return 0;
+    a->sumsq += a->win_sumsq;
+    a->peak   = FFMAX(a->peak, FFMAX(a->win_max, -a->win_min));
+    return easy_audio_analyzer_close_window(a);
+}
+
+static inline double easy_loudness(double mean_square)
+{
+    return mean_square > 0 ? -0.691 + 10 * log10(mean_square) : -HUGE_VAL;
+}
+
+/**
+ * Compute the whole-stream peak, RMS and loudness.
+ */
+static inline void easy_audio_analyzer_get_summary(const EasyAudioAnalyzer *a, EasyAudioSummary *summary)
+{
+    double block, gated = 0, threshold;
+    int64_t nb_gated = 0;
+
+    memset(summary, 0, sizeof(*summary));
+    summary->nb_samples         = a->nb_samples;
+    summary->peak_dbfs          = a->peak > 0 ? 20 * log10(a->peak) : -HUGE_VAL;
+    summary->rms_dbfs           = a->sumsq > 0 ? 10 * log10(a->sumsq / ((double)a->nb_samples * a->channels)) : -HUGE_VAL;
+    summary->max_momentary_lufs = -HUGE_VAL;
+
+    /* absolute gate, every 400 ms block ending on a step */
+    for (int64_t i = EASY_LOUDNESS_STEPS - 1; i < a->nb_steps; i++) {
+        block = 0;
+        for (int j = 0; j < EASY_LOUDNESS_STEPS; j++)
+            block += a->steps[i - j];
+        block /= EASY_LOUDNESS_STEPS;
+        summary->max_momentary_lufs = FFMAX(summary->max_momentary_lufs, easy_loudness(block));
+        if (easy_loudness(block) > EASY_LOUDNESS_ABSOLUTE_GATE) {
+            gated += block;
+            nb_gated++;
+        }
+    }
+    summary->integrated_lufs = -HUGE_VAL;
+    if (!nb_gated)
+        return;
+
+    /* relative gate, 10 LU under the loudness of the blocks above the absolute gate */
+    threshold = easy_loudness(gated / nb_gated) + EASY_LOUDNESS_RELATIVE_GATE;
+    gated    = 0;
+    nb_gated = 0;
+    for (int64_t i = EASY_LOUDNESS_STEPS - 1; i < a->nb_steps; i++) {
+        block = 0;
+        for (int j = 0; j < EASY_LOUDNESS_STEPS; j++)
+            block += a->steps[i - j];
+        block /= EASY_LOUDNESS_STEPS;
+        if (easy_loudness(block) > EASY_LOUDNESS_ABSOLUTE_GATE && easy_loudness(block) > threshold) {
+            gated += block;
+            nb_gated++;
+        }
+    }
+    if (nb_gated)
+        summary->integrated_lufs = easy_loudness(gated / nb_gated);
+}
+
+/**
+ * Pick the waveform level to draw at a given zoom.
+ *
+ * @param a The analyzer.
+ * @param max_bins The most bins the display can show, e.g. its width in pixels.
+ *
+ * @return The most detailed level with at most max_bins bins, the coarsest one
+ *         if none fits.
+ */
+static inline const EasyWaveformLevel *easy_audio_waveform(const EasyAudioAnalyzer *a, int64_t max_bins)
+{
+    for (int l = 0; l < a->nb_levels; l++)
+        if (a->levels[l].nb_bins <= max_bins)
+            return &a->levels[l];
+    return &a->levels[a->nb_levels - 1];
+}
+
+/**
+ * Write every waveform level to a file, for a UI to load and zoom without
+ * decoding again.
+ *
+ * The file holds "EWAV", then sample_rate, channels, window and the number
+ * of levels as 32-bit integers, then per level its 64-bit bin count and its
+ * bins, 3 x 16 bits each (min, max, rms), in native byte order.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_audio_waveform_write(const EasyAudioAnalyzer *a, const char *filename)
+{
+    int32_t header[4] = { a->sample_rate, a->channels, a->window, a->nb_levels };
+    FILE *f = fopen(filename, "wb");
+    int ret = 0;
+
+    if (!f) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open %s\n", filename);
+        return AVERROR(errno);
+    }
+    if (fwrite(EASY_WAVEFORM_MAGIC, 4, 1, f) != 1 || fwrite(header, sizeof(header), 1, f) != 1)
+        ret = AVERROR(EIO);
+    for (int l = 0; l < a->nb_levels && ret >= 0; l++) {
+        const EasyWaveformLevel *level = &a->levels[l];
+        if (fwrite(&level->nb_bins, sizeof(level->nb_bins), 1, f) != 1 ||
+            fwrite(level->bins, sizeof(*level->bins), (size_t)level->nb_bins, f) != (size_t)level->nb_bins)
+            ret = AVERROR(EIO);
+    }
+    if (fclose(f) && ret >= 0)
+        ret = AVERROR(EIO);
+    return ret;
+}
+
+#endif // __EASY_AUDIO_H__
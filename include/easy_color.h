@@ -0,0 +1,285 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_COLOR_H__
+#define __EASY_COLOR_H__
+
+#include "easy_common.h"
+#include "easy_kernels.h"
+
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/pixfmt.h>
+
+#include <stdint.h>
+
+#define EASY_YUV_TABLE_BITS  16
+#define EASY_YUV_TABLE_SIZE  1024 // enough entries for 10-bit samples
+
+/**
+ * Fixed-point lookup tables for one YUV->RGB matrix, range and bit depth.
+ *
+ * Every table entry already contains the offset, range expansion and matrix
+ * coefficient for one sample value, so converting a pixel costs five table
+ * loads, a few additions and a clamp.
+ */
+typedef struct EasyYuvToRgb {
+    enum AVColorSpace colorspace; ///< matrix the tables were built for
+    enum AVColorRange range;      ///< range the tables were built for
+    int               depth;      ///< bits per sample the tables were built for, 0 if not built yet
+    int32_t           y[EASY_YUV_TABLE_SIZE];
+    int32_t           v_r[EASY_YUV_TABLE_SIZE];
+    int32_t           u_g[EASY_YUV_TABLE_SIZE];
+    int32_t           v_g[EASY_YUV_TABLE_SIZE];
+    int32_t           u_b[EASY_YUV_TABLE_SIZE];
+    EasyKernelYuvCoeffs coeffs;   ///< the same matrix for the compiled 8-bit kernel
+} EasyYuvToRgb;
+
+/**
+ * Get the luma coefficients Kr and Kb of a YUV matrix.
+ * Unknown matrices fall back to BT.601.
+ */
+static inline void easy_yuv_coefficients(enum AVColorSpace colorspace, double *kr, double *kb)
+{
+    switch (colorspace) {
+    case AVCOL_SPC_BT709:
+        *kr = 0.2126; *kb = 0.0722;
+        break;
+    case AVCOL_SPC_BT2020_NCL:
+    case AVCOL_SPC_BT2020_CL:
+        *kr = 0.2627; *kb = 0.0593;
+        break;
+    case AVCOL_SPC_SMPTE240M:
+        *kr = 0.212;  *kb = 0.087;
+        break;
+    case AVCOL_SPC_FCC:
+        *kr = 0.30;   *kb = 0.11;
+        break;
+    default: // BT.470BG, SMPTE170M
+        *kr = 0.299;  *kb = 0.114;
+        break;
+    }
+}
+
+/**
+ * Build the conversion tables for a matrix, range and bit depth.
+ *
+ * @param ctx The tables to fill.
+ * @param colorspace The YUV matrix.
+ * @param range AVCOL_RANGE_JPEG for full range, anything else for limited range.
+ * @param depth The number of bits per sample, 8 to 10.
+ */
+static inline void easy_yuv_to_rgb_init(EasyYuvToRgb *ctx, enum AVColorSpace colorspace,
+                                        enum AVColorRange range, int depth)
+{
+    const double one = (double)(1 << EASY_YUV_TABLE_BITS);
+    const int max = (1 << depth) - 1, mid = 1 << (depth - 1);
+    double kr, kb, kg, y_scale, c_scale;
+    int y_offset;
+
+    easy_yuv_coefficients(colorspace, &kr, &kb);
+    kg = 1.0 - kr - kb;
+
+    if (range == AVCOL_RANGE_JPEG) {
+        y_offset = 0;
+        y_scale  = 255.0 / max;
+        c_scale  = 255.0 / max;
+    } else {
+        y_offset = 16 << (depth - 8);
+        y_scale  = 255.0 / (219 << (depth - 8));
+        c_scale  = 255.0 / (224 << (depth - 8));
+    }
+
+    for (int i = 0; i < EASY_YUV_TABLE_SIZE; i++) {
+        double y = (i - y_offset) * y_scale;
+        double c = (i - mid) * c_scale;
+
+        /* the rounding bias of the final shift is folded into the luma table */
+        ctx->y[i]   = (int32_t)(y * one + (y >= 0 ? 0.5 : -0.5)) + (1 << (EASY_YUV_TABLE_BITS - 1));
+        ctx->v_r[i] = (int32_t)(c * 2.0 * (1.0 - kr) * one);
+        ctx->u_g[i] = (int32_t)(-c * 2.0 * kb * (1.0 - kb) / kg * one);
+        ctx->v_g[i] = (int32_t)(-c * 2.0 * kr * (1.0 - kr) / kg * one);
+        ctx->u_b[i] = (int32_t)(c * 2.0 * (1.0 - kb) * one);
+    }
+
+    ctx->coeffs.y_mul = (int32_t)(y_scale * one + 0.5);
+    ctx->coeffs.y_add = -y_offset * ctx->coeffs.y_mul + (1 << (EASY_YUV_TABLE_BITS - 1));
+    ctx->coeffs.v_r   = (int32_t)(c_scale * 2.0 * (1.0 - kr) * one + 0.5);
+    ctx->coeffs.u_g   = (int32_t)(-c_scale * 2.0 * kb * (1.0 - kb) / kg * one - 0.5);
+    ctx->coeffs.v_g   = (int32_t)(-c_scale * 2.0 * kr * (1.0 - kr) / kg * one - 0.5);
+    ctx->coeffs.u_b   = (int32_t)(c_scale * 2.0 * (1.0 - kb) * one + 0.5);
+
+    ctx->colorspace = colorspace;
+    ctx->range      = range;
+    ctx->depth      = depth;
+}
+
+/* branchless clamp, decoded video hits both ends often enough to defeat prediction */
+static inline uint8_t easy_yuv_clip(int32_t v)
+{
+    v >>= EASY_YUV_TABLE_BITS;
+    v &= ~(v >> 31);
+    v |= (255 - v) >> 31;
+    return (uint8_t)v;
+}
+
+/**
+ * Convert planar YUV rows to packed RGB24 with prepared tables.
+ *
+ * @param ctx The conversion tables.
+ * @param data The Y, U and V plane pointers.
+ * @param linesize The Y, U and V linesizes in bytes.
+ * @param width The width of the image in pixels.
+ * @param height The height of the image in pixels.
+ * @param log2_chroma_w The horizontal chroma subsampling shift.
+ * @param log2_chroma_h The vertical chroma subsampling shift.
+ * @param rgb The destination buffer.
+ * @param rgb_linesize The number of bytes in a row of the destination.
+ */
+static inline void easy_yuv_to_rgb24_planes(const EasyYuvToRgb *ctx, const uint8_t *const data[3],
+                                            const int linesize[3], int width, int height,
+                                            int log2_chroma_w, int log2_chroma_h,
+                                            uint8_t *rgb, int rgb_linesize)
+{
+#ifdef EASY_HAVE_KERNELS
+    /* the compiled library has this vectorized for the running CPU */
+    if (ctx->depth == 8 &&
+        !easy_kernel_yuv_to_rgb24(&ctx->coeffs, data, linesize, width, height,
+                                  log2_chroma_w, log2_chroma_h, rgb, rgb_linesize))
+        return;
+#endif
+    for (int j = 0; j < height; j++) {
+        uint8_t *dst = rgb + (ptrdiff_t)j * rgb_linesize;
+
+        if (ctx->depth > 8) {
+            const uint8_t *y = data[0] + (ptrdiff_t)j * linesize[0];
+            const uint8_t *u = data[1] + (ptrdiff_t)(j >> log2_chroma_h) * linesize[1];
+            const uint8_t *v = data[2] + (ptrdiff_t)(j >> log2_chroma_h) * linesize[2];
+            const int mask = EASY_YUV_TABLE_SIZE - 1;
+
+            for (int i = 0; i < width; i++) {
+                /* samples are little-endian 16-bit words */
+                int c  = i >> log2_chroma_w;
+                int yy = ctx->y[(y[2 * i] | y[2 * i + 1] << 8) & mask];
+                int cu = (u[2 * c] | u[2 * c + 1] << 8) & mask;
+                int cv = (v[2 * c] | v[2 * c + 1] << 8) & mask;
+
+                dst[3 * i + 0] = easy_yuv_clip(yy + ctx->v_r[cv]);
+                dst[3 * i + 1] = easy_yuv_clip(yy + ctx->u_g[cu] + ctx->v_g[cv]);
+                dst[3 * i + 2] = easy_yuv_clip(yy + ctx->u_b[cu]);
+            }
+        } else if (log2_chroma_w == 1) {
+            const uint8_t *y = data[0] + (ptrdiff_t)j * linesize[0];
+            const uint8_t *u = data[1] + (ptrdiff_t)(j >> log2_chroma_h) * linesize[1];
+            const uint8_t *v = data[2] + (ptrdiff_t)(j >> log2_chroma_h) * linesize[2];
+
+            /* two luma samples share one chroma pair, look the chroma terms up once */
+            for (int c = 0; c < width >> 1; c++) {
+                int r  = ctx->v_r[v[c]];
+                int g  = ctx->u_g[u[c]] + ctx->v_g[v[c]];
+                int b  = ctx->u_b[u[c]];
+                int y0 = ctx->y[y[2 * c]];
+                int y1 = ctx->y[y[2 * c + 1]];
+
+                dst[6 * c + 0] = easy_yuv_clip(y0 + r);
+                dst[6 * c + 1] = easy_yuv_clip(y0 + g);
+                dst[6 * c + 2] = easy_yuv_clip(y0 + b);
+                dst[6 * c + 3] = easy_yuv_clip(y1 + r);
+                dst[6 * c + 4] = easy_yuv_clip(y1 + g);
+                dst[6 * c + 5] = easy_yuv_clip(y1 + b);
+            }
+            if (width & 1) {
+                int c  = width >> 1;
+                int yy = ctx->y[y[width - 1]];
+
+                dst[3 * (width - 1) + 0] = easy_yuv_clip(yy + ctx->v_r[v[c]]);
+                dst[3 * (width - 1) + 1] = easy_yuv_clip(yy + ctx->u_g[u[c]] + ctx->v_g[v[c]]);
+                dst[3 * (width - 1) + 2] = easy_yuv_clip(yy + ctx->u_b[u[c]]);
+            }
+        } else {
+            const uint8_t *y = data[0] + (ptrdiff_t)j * linesize[0];
+            const uint8_t *u = data[1] + (ptrdiff_t)(j >> log2_chroma_h) * linesize[1];
+            const uint8_t *v = data[2] + (ptrdiff_t)(j >> log2_chroma_h) * linesize[2];
+
+            for (int i = 0; i < width; i++) {
+                int c  = i >> log2_chroma_w;
+                int yy = ctx->y[y[i]];
+
+                dst[3 * i + 0] = easy_yuv_clip(yy + ctx->v_r[v[c]]);
+                dst[3 * i + 1] = easy_yuv_clip(yy + ctx->u_g[u[c]] + ctx->v_g[v[c]]);
+                dst[3 * i + 2] = easy_yuv_clip(yy + ctx->u_b[u[c]]);
+            }
+        }
+    }
+}
+
+/**
+ * Convert a YUV frame to packed RGB24, honoring frame->colorspace and
+ * frame->color_range.
+ *
+ * Supported formats are yuv420p, yuv422p, yuv444p, their yuvj variants and
+ * yuv420p10le. Unspecified matrices are guessed from the frame height (BT.709
+ * for HD, BT.601 otherwise), unspecified ranges are treated as limited.
+ *
+ * @param ctx Tables reused between calls, rebuilt only when the frame's
+ *            matrix, range or depth change. Zero-initialize it before the first call.
+ * @param frame The frame to convert.
+ * @param rgb The destination buffer, at least rgb_linesize * frame->height bytes.
+ * @param rgb_linesize The number of bytes in a row of the destination.
+ *
+ * @return 0 on success, AVERROR(EINVAL) for unsupported pixel formats.
+ */
+static inline int easy_yuv_to_rgb24(EasyYuvToRgb *ctx, const AVFrame *frame, uint8_t *rgb, int rgb_linesize)
+{
+    enum AVColorSpace colorspace = frame->colorspace;
+    enum AVColorRange range = frame->color_range;
+    const AVPixFmtDescriptor *desc;
+    int depth;
+
+    switch (frame->format) {
+    case AV_PIX_FMT_YUVJ420P:
+    case AV_PIX_FMT_YUVJ422P:
+    case AV_PIX_FMT_YUVJ444P:
+        range = AVCOL_RANGE_JPEG;
+        depth = 8;
+        break;
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUV422P:
+    case AV_PIX_FMT_YUV444P:
+        depth = 8;
+        break;
+    case AV_PIX_FMT_YUV420P10LE:
+        depth = 10;
+        break;
+    default:
+        av_log(NULL, AV_LOG_ERROR, "Unsupported pixel format for YUV to RGB conversion\n");
+        return AVERROR(EINVAL);
+    }
+    desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+
+    if (colorspace == AVCOL_SPC_UNSPECIFIED || colorspace == AVCOL_SPC_RESERVED)
+        colorspace = frame->height > 576 ? AVCOL_SPC_BT709 : AVCOL_SPC_SMPTE170M;
+    if (range != AVCOL_RANGE_JPEG)
+        range = AVCOL_RANGE_MPEG;
+
+    if (ctx->depth != depth || ctx->colorspace != colorspace || ctx->range != range)
+        easy_yuv_to_rgb_init(ctx, colorspace, range, depth);
+
+    easy_yuv_to_rgb24_planes(ctx, (const uint8_t *const *)frame->data, frame->linesize,
+                             frame->width, frame->height, desc->log2_chroma_w, desc->log2_chroma_h,
+                             rgb, rgb_linesize);
+    return 0;
+}
+
+#endif // __EASY_COLOR_H__
@@ -15,6 +15,21 @@
 #ifndef __EASY_COMMON_H__
 #define __EASY_COMMON_H__
 
+/* symbols of the compiled libeasyffmpeg */
+#if defined(_WIN32)
+#  if defined(EASY_BUILDING_DLL)
+#    define EASY_API __declspec(dllexport)
+#  elif defined(EASY_USING_DLL)
+#    define EASY_API __declspec(dllimport)
+#  else
+#    define EASY_API
+#  endif
+#elif defined(__GNUC__)
+#  define EASY_API __attribute__((visibility("default")))
+#else
+#  define EASY_API
+#endif
+
 #define CHECK_ERROR(err) \
     if ((err) < 0) { \
         char errbuf[128]; \
@@ -0,0 +1,250 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_COMPOSITOR_H__
+#define __EASY_COMPOSITOR_H__
+
+#include "easy_common.h"
+#include "easy_mosaic.h"
+#include "easy_thread.h"
+
+#include <libavutil/frame.h>
+#include <libavutil/mathematics.h>
+#include <libavutil/mem.h>
+#include <libswscale/swscale.h>
+
+#include <pthread.h>
+
+/* frames an input may run ahead of the output before the oldest is dropped */
+#define EASY_COMPOSITOR_QUEUE 8
+
+typedef struct EasyCompositorInput {
+    pthread_mutex_t    lock;     ///< push may come from the input's decoder thread
+    AVFrame           *queue[EASY_COMPOSITOR_QUEUE]; ///< frames not shown yet, in pts order
+    int64_t            queue_pts[EASY_COMPOSITOR_QUEUE];
+    int                head;
+    int                count;
+    AVFrame           *current;  ///< shown until a newer frame is due
+    int                dirty;    ///< current changed since it was last drawn
+    int                last_w;   ///< size of the last picture drawn, to clear leftovers
+    int                last_h;
+    struct SwsContext *sws;
+    int64_t            dropped;
+    int64_t            repeated;
+} EasyCompositorInput;
+
+/**
+ * Composes N inputs into a grid of cells of one YUV420P frame.
+ *
+ * Each output frame shows, per input, the latest frame whose pts is not
+ * after the output pts. Inputs without a new frame repeat their last one,
+ * and their cell is not redrawn at all.
+ */
+typedef struct EasyCompositor {
+    EasyMosaic           grid;
+    EasyCompositorInput *inputs;
+    int                  nb_inputs;
+    AVRational           time_base;  ///< of the output pts and of the pts given to push
+    EasyWorkerPool       pool;
+} EasyCompositor;
+
+/**
+ * Release a compositor and every frame it holds.
+ */
+static inline void easy_compositor_uninit(EasyCompositor *comp)
+{
+    for (int i = 0; comp->inputs && i < comp->nb_inputs; i++) {
+        EasyCompositorInput *in = &comp->inputs[i];
+        for (int j = 0; j < in->count; j++)
+            av_frame_free(&in->queue[(in->head + j) % EASY_COMPOSITOR_QUEUE]);
+        av_frame_free(&in->current);
+        sws_freeContext(in->sws);
+        pthread_mutex_destroy(&in->lock);
+    }
+    av_freep(&comp->inputs);
+    easy_worker_pool_uninit(&comp->pool);
+    easy_mosaic_uninit(&comp->grid);
+}
+
+/**
+ * Set up a compositor.
+ *
+ * Inputs decoded at exactly cell_w x cell_h in YUV420P are copied plane by
+ * plane, any other size or format is scaled into the cell.
+ *
+ * @param comp The compositor to initialize.
+ * @param nb_inputs The number of inputs.
+ * @param cols The number of cells per row, rows follow from nb_inputs.
+ * @param cell_w The width of a cell, rounded up to even.
+ * @param cell_h The height of a cell, rounded up to even.
+ * @param time_base The time base of the pts given to the compositor.
+ * @param nb_threads The number of threads drawing cells, <= 0 for one per CPU.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_compositor_init(EasyCompositor *comp, int nb_inputs, int cols, int cell_w, int cell_h,
+                                       AVRational time_base, int nb_threads)
+{
+    int ret;
+
+    memset(comp, 0, sizeof(*comp));
+    if (nb_inputs <= 0 || cols <= 0)
+        return AVERROR(EINVAL);
+    comp->time_base = time_base;
+
+    if ((ret = easy_mosaic_init(&comp->grid, cols, (nb_inputs + cols - 1) / cols, cell_w, cell_h, 0)) < 0)
+        return ret;
+    if ((ret = easy_worker_pool_init(&comp->pool, FFMIN(nb_threads > 0 ? nb_threads : av_cpu_count(),
+                                                        nb_inputs))) < 0) {
+        easy_mosaic_uninit(&comp->grid);
+        return ret;
+    }
+    comp->inputs = (EasyCompositorInput *)av_calloc(nb_inputs, sizeof(*comp->inputs));
+    if (!comp->inputs) {
+        easy_compositor_uninit(comp);
+        return AVERROR(ENOMEM);
+    }
+    for (int i = 0; i < nb_inputs; i++) {
+        pthread_mutex_init(&comp->inputs[i].lock, NULL);
+        comp->nb_inputs++;
+    }
+    return 0;
+}
+
+/**
+ * Queue a frame of one input.
+ *
+ * Can be called from the decoding thread of each input while another
+ * thread composes.
+ *
+ * @param comp The compositor.
+ * @param index The input.
+ * @param frame The frame, referenced, the caller keeps its own reference.
+ * @param time_base The time base of frame->pts.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_compositor_push(EasyCompositor *comp, int index, const AVFrame *frame, AVRational time_base)
+{
+    EasyCompositorInput *in;
+    AVFrame *ref;
+    int64_t pts;
+
+    if (index < 0 || index >= comp->nb_inputs)
+        return AVERROR(EINVAL);
+    in = &comp->inputs[index];
+    if (!(ref = av_frame_clone(frame)))
+        return AVERROR(ENOMEM);
+    pts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+    if (pts != AV_NOPTS_VALUE)
+        pts = av_rescale_q(pts, time_base, comp->time_base);
+
+    pthread_mutex_lock(&in->lock);
+    if (in->count == EASY_COMPOSITOR_QUEUE) {
+        /* the output is not keeping up, the oldest pending frame is never shown */
+        av_frame_free(&in->queue[in->head]);
+        in->head = (in->head + 1) % EASY_COMPOSITOR_QUEUE;
+        in->count--;
+        in->dropped++;
+    }
+    /* frames without pts are shown as soon as possible */
+    if (pts == AV_NOPTS_VALUE)
+        pts = INT64_MIN;
+    in->queue[(in->head + in->count) % EASY_COMPOSITOR_QUEUE]     = ref;
+    in->queue_pts[(in->head + in->count) % EASY_COMPOSITOR_QUEUE] = pts;
+    in->count++;
+    pthread_mutex_unlock(&in->lock);
+    return 0;
+}
+
+/* pick the frame of each input due at pts, skipping frames already late */
+static inline void easy_compositor_advance(EasyCompositorInput *in, int64_t pts)
+{
+    int advanced = 0;
+
+    pthread_mutex_lock(&in->lock);
+    while (in->count && in->queue_pts[in->head] <= pts) {
+        if (advanced)
+            in->dropped++;
+        av_frame_free(&in->current);
+        in->current = in->queue[in->head];
+        in->queue[in->head] = NULL;
+        in->head = (in->head + 1) % EASY_COMPOSITOR_QUEUE;
+        in->count--;
+        advanced = 1;
+    }
+    pthread_mutex_unlock(&in->lock);
+
+    if (advanced)
+        in->dirty = 1;
+    else if (in->current)
+        in->repeated++;
+}
+
+static inline int easy_compositor_draw(void *opaque, int job, int worker)
+{
+    EasyCompositor *comp = (EasyCompositor *)opaque;
+    EasyCompositorInput *in = &comp->inputs[job];
+    int ret;
+    (void)worker;
+
+    if (!in->dirty)
+        return 0;
+    /* a smaller picture than the last one would leave parts of it visible */
+    if (in->current->width != in->last_w || in->current->height != in->last_h) {
+        easy_mosaic_clear_tile(&comp->grid, job);
+        in->last_w = in->current->width;
+        in->last_h = in->current->height;
+    }
+    if ((ret = easy_mosaic_put(&comp->grid, job, in->current, &in->sws)) < 0)
+        return ret;
+    in->dirty = 0;
+    return 0;
+}
+
+/**
+ * Compose the output frame at a pts.
+ *
+ * Cells are drawn in parallel, one job per input. If the previous output
+ * frame is still referenced elsewhere (e.g. queued in an encoder) it is
+ * copied first, so frames already handed out never change.
+ *
+ * @param comp The compositor.
+ * @param pts The output time, in the compositor time base.
+ * @param out Set to the composed YUV420P frame, owned by the compositor and
+ *            valid until the next call. Pass it to easy_render_yuv420p() or
+ *            reference it with av_frame_ref() to keep it, e.g. for an encoder.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_compositor_compose(EasyCompositor *comp, int64_t pts, AVFrame **out)
+{
+    int ret;
+
+    for (int i = 0; i < comp->nb_inputs; i++)
+        easy_compositor_advance(&comp->inputs[i], pts);
+
+    if ((ret = av_frame_make_writable(comp->grid.frame)) < 0)
+        return ret;
+    EASY_TRACE_CALL("compose", ret = easy_worker_pool_execute(&comp->pool, easy_compositor_draw, comp,
+                                                              comp->nb_inputs));
+    if (ret < 0)
+        return ret;
+
+    comp->grid.frame->pts = pts;
+    *out = comp->grid.frame;
+    return 0;
+}
+
+#endif // __EASY_COMPOSITOR_H__
@@ -0,0 +1,354 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_DECODER_POOL_H__
+#define __EASY_DECODER_POOL_H__
+
+#include "easy_common.h"
+#include "easy_trace.h"
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#define EASY_DECODER_POOL_MAX_ENTRIES 64
+
+/**
+ * What makes an opened decoder reusable for another stream: the codec, the
+ * stream parameters it was opened with and the options set on it.
+ */
+typedef struct EasyDecoderKey {
+    enum AVCodecID     codec_id;
+    const AVCodec     *codec;
+    int                width;
+    int                height;
+    enum AVPixelFormat pix_fmt;
+    int                flags;
+    int                flags2;
+    int                thread_count;
+    int                thread_type;
+    int                lowres;
+    void              *opaque;       ///< e.g. the EasyFramePool of easy_frame_pool_install()
+    int (*get_buffer2)(struct AVCodecContext *s, AVFrame *frame, int flags);
+    uint32_t           extradata_hash;
+    int                extradata_size;
+} EasyDecoderKey;
+
+typedef struct EasyDecoderPoolEntry {
+    AVCodecContext *avctx;
+    EasyDecoderKey  key;
+    uint8_t        *extradata;      ///< copy, the hash only rules out mismatches
+    int             leased;
+    uint64_t        last_used;
+} EasyDecoderPoolEntry;
+
+/**
+ * Opened decoders kept across inputs sharing the same codec parameters.
+ *
+ * Opening a decoder builds its tables and, with threading, its worker
+ * threads. For many short clips of the same encode that setup dominates, so
+ * decoders are flushed and parked here instead of being freed.
+ */
+typedef struct EasyDecoderPool {
+    pthread_mutex_t      lock;
+    int                  max_idle;
+    int                  nb_entries;
+    EasyDecoderPoolEntry entries[EASY_DECODER_POOL_MAX_ENTRIES];
+    uint64_t             clock;
+
+    /* statistics, protected by lock */
+    uint64_t             hits;
+    uint64_t             misses;
+    uint64_t             evictions;
+    int64_t              open_us;    ///< startup time of misses, see easy_decoder_pool_open2()
+    int64_t              reuse_us;   ///< startup time of hits, measured the same way
+} EasyDecoderPool;
+
+/**
+ * Counters exposed by easy_decoder_pool_get_stats().
+ */
+typedef struct EasyDecoderPoolStats {
+    uint64_t hits;        ///< opens served by a parked decoder
+    uint64_t misses;      ///< opens that ran avcodec_open2()
+    uint64_t evictions;   ///< parked decoders freed to stay within max_idle
+    int      idle;        ///< decoders parked right now
+    int      leased;      ///< decoders handed out right now
+    double   open_ms;     ///< mean startup time of a miss, e.g. the whole easy_open_video2()
+    double   reuse_ms;    ///< mean startup time of a hit, measured over the same steps
+} EasyDecoderPoolStats;
+
+static inline uint32_t easy_decoder_pool_hash(const uint8_t *data, int size)
+{
+    uint32_t h = 2166136261u; // FNV-1a
+    for (int i = 0; i < size; i++)
+        h = (h ^ data[i]) * 16777619u;
+    return h;
+}
+
+static inline void easy_decoder_pool_make_key(const AVCodecContext *avctx, const AVCodec *codec, EasyDecoderKey *key)
+{
+    memset(key, 0, sizeof(*key));
+    key->codec_id       = avctx->codec_id;
+    key->codec          = codec;
+    key->width          = avctx->width;
+    key->height         = avctx->height;
+    key->pix_fmt        = avctx->pix_fmt;
+    key->flags          = avctx->flags;
+    key->flags2         = avctx->flags2;
+    key->thread_count   = avctx->thread_count;
+    key->thread_type    = avctx->thread_type;
+    key->lowres         = avctx->lowres;
+    key->opaque         = avctx->opaque;
+    key->get_buffer2    = avctx->get_buffer2;
+    key->extradata_size = avctx->extradata ? avctx->extradata_size : 0;
+    key->extradata_hash = easy_decoder_pool_hash(avctx->extradata, key->extradata_size);
+}
+
+/**
+ * Allocate a decoder pool.
+ *
+ * @param pool A pointer to a pointer to an EasyDecoderPool, which will be allocated and initialized.
+ * @param max_idle The number of flushed decoders kept for reuse, the least recently used go first.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_decoder_pool_alloc(EasyDecoderPool **pool, int max_idle)
+{
+    *pool = (EasyDecoderPool *)av_mallocz(sizeof(**pool));
+    if (!*pool)
+        return AVERROR(ENOMEM);
+    if (pthread_mutex_init(&(*pool)->lock, NULL)) {
+        av_freep(pool);
+        return AVERROR(ENOMEM);
+    }
+    (*pool)->max_idle = FFMIN(FFMAX(max_idle, 0), EASY_DECODER_POOL_MAX_ENTRIES);
+    return 0;
+}
+
+/* drop an entry, called with the lock held */
+static inline void easy_decoder_pool_remove(EasyDecoderPool *pool, int index, AVCodecContext **avctx)
+{
+    EasyDecoderPoolEntry *e = &pool->entries[index];
+
+    *avctx = e->avctx;
+    av_freep(&e->extradata);
+    pool->entries[index] = pool->entries[--pool->nb_entries];
+}
+
+/**
+ * Free a decoder pool and its parked decoders, and set the pointer to NULL.
+ *
+ * @note Every decoder handed out must be released before this call.
+ */
+static inline void easy_decoder_pool_free(EasyDecoderPool **pool)
+{
+    if (!*pool)
+        return;
+    while ((*pool)->nb_entries) {
+        AVCodecContext *avctx;
+        if ((*pool)->entries[0].leased)
+            av_log(NULL, AV_LOG_WARNING, "Decoder pool freed with a decoder still in use\n");
+        easy_decoder_pool_remove(*pool, 0, &avctx);
+        avcodec_free_context(&avctx);
+    }
+    pthread_mutex_destroy(&(*pool)->lock);
+    av_freep(pool);
+}
+
+/*
+ * Carry the stream parameters that are not part of the key over to a parked
+ * decoder, decoders fall back to them for frames whose bitstream does not
+ * signal them (aspect ratio, color properties).
+ */
+static inline void easy_decoder_pool_copy_params(AVCodecContext *dst, const AVCodecContext *src)
+{
+    dst->codec_tag              = src->codec_tag;
+    dst->bit_rate               = src->bit_rate;
+    dst->bits_per_coded_sample  = src->bits_per_coded_sample;
+    dst->bits_per_raw_sample    = src->bits_per_raw_sample;
+    dst->profile                = src->profile;
+    dst->level                  = src->level;
+    dst->field_order            = src->field_order;
+    dst->color_range            = src->color_range;
+    dst->color_primaries        = src->color_primaries;
+    dst->color_trc              = src->color_trc;
+    dst->colorspace             = src->colorspace;
+    dst->chroma_sample_location = src->chroma_sample_location;
+    dst->sample_aspect_ratio    = src->sample_aspect_ratio;
+    dst->framerate              = src->framerate;
+    dst->pkt_timebase           = src->pkt_timebase;
+}
+
+/**
+ * Open a configured decoder context, or swap it for a parked decoder that
+ * was opened with the same parameters and options.
+ *
+ * Set the context up as for avcodec_open2() (stream parameters, flags,
+ * threading, frame pool) and pass it here instead. On a hit it is freed and
+ * replaced by the parked one, which has been flushed and gets the stream
+ * parameters outside the key (aspect ratio, color properties, profile,
+ * frame rate, pkt_timebase) of the new context.
+ *
+ * @param pool The pool.
+ * @param avctx A pointer to the configured context, replaced on a hit.
+ * @param codec The decoder.
+ * @param start The av_gettime_relative() value the caller started opening
+ *              the input at, the startup time of the statistics runs from
+ *              there so hits and misses cover the same steps.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_decoder_pool_open2(EasyDecoderPool *pool, AVCodecContext **avctx, const AVCodec *codec,
+                                          int64_t start)
+{
+    EasyDecoderPoolEntry *e = NULL;
+    EasyDecoderKey key;
+    int ret;
+
+    easy_decoder_pool_make_key(*avctx, codec, &key);
+
+    pthread_mutex_lock(&pool->lock);
+    for (int i = 0; i < pool->nb_entries; i++) {
+        EasyDecoderPoolEntry *c = &pool->entries[i];
+        if (!c->leased && !memcmp(&c->key, &key, sizeof(key)) &&
+            (!key.extradata_size || !memcmp(c->extradata, (*avctx)->extradata, key.extradata_size))) {
+            e = c;
+            break;
+        }
+    }
+    if (e) {
+        AVCodecContext *parked = e->avctx;
+        e->leased    = 1;
+        e->last_used = ++pool->clock;
+        pthread_mutex_unlock(&pool->lock);
+
+        easy_decoder_pool_copy_params(parked, *avctx);
+        avcodec_free_context(avctx);
+        *avctx = parked;
+
+        pthread_mutex_lock(&pool->lock);
+        pool->hits++;
+        pool->reuse_us += av_gettime_relative() - start;
+        pthread_mutex_unlock(&pool->lock);
+        return 0;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    EASY_TRACE_CALL("open_decoder", ret = avcodec_open2(*avctx, codec, NULL));
+    if (ret < 0)
+        return ret;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->misses++;
+    pool->open_us += av_gettime_relative() - start;
+    if (pool->nb_entries < EASY_DECODER_POOL_MAX_ENTRIES) {
+        e = &pool->entries[pool->nb_entries];
+        e->extradata = key.extradata_size ? (uint8_t *)av_memdup((*avctx)->extradata, key.extradata_size) : NULL;
+        /* without the copy the entry could never be matched, keep it out of the pool */
+        if (!key.extradata_size || e->extradata) {
+            e->avctx     = *avctx;
+            memcpy(&e->key, &key, sizeof(key)); // padding included, keys are compared with memcmp
+            e->leased    = 1;
+            e->last_used = ++pool->clock;
+            pool->nb_entries++;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+/**
+ * Like easy_decoder_pool_open2(), timing the startup from this call.
+ */
+static inline int easy_decoder_pool_open(EasyDecoderPool *pool, AVCodecContext **avctx, const AVCodec *codec)
+{
+    return easy_decoder_pool_open2(pool, avctx, codec, av_gettime_relative());
+}
+
+/**
+ * Give a decoder back: flush it and park it for the next input with the
+ * same parameters, evicting the least recently used parked decoder when
+ * more than max_idle are parked. Decoders that did not come from the pool
+ * are freed.
+ *
+ * @param pool The pool.
+ * @param avctx A pointer to the decoder, set to NULL.
+ */
+static inline void easy_decoder_pool_release(EasyDecoderPool *pool, AVCodecContext **avctx)
+{
+    AVCodecContext *evicted = NULL;
+    int idle = 0, lru = -1, found = 0;
+
+    if (!*avctx)
+        return;
+
+    /* drops queued frames and the draining state, the decoder takes new packets again */
+    avcodec_flush_buffers(*avctx);
+
+    pthread_mutex_lock(&pool->lock);
+    for (int i = 0; i < pool->nb_entries; i++) {
+        EasyDecoderPoolEntry *e = &pool->entries[i];
+        if (e->avctx == *avctx) {
+            e->leased    = 0;
+            e->last_used = ++pool->clock;
+            found        = 1;
+        }
+    }
+    for (int i = 0; i < pool->nb_entries; i++) {
+        EasyDecoderPoolEntry *e = &pool->entries[i];
+        if (e->leased)
+            continue;
+        idle++;
+        if (lru < 0 || e->last_used < pool->entries[lru].last_used)
+            lru = i;
+    }
+    if (idle > pool->max_idle) {
+        easy_decoder_pool_remove(pool, lru, &evicted);
+        pool->evictions++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    avcodec_free_context(&evicted);
+    if (!found)
+        avcodec_free_context(avctx);
+    *avctx = NULL;
+}
+
+/**
+ * Read the counters of a decoder pool, e.g. to compare per-clip startup
+ * time with and without the pool.
+ */
+static inline void easy_decoder_pool_get_stats(EasyDecoderPool *pool, EasyDecoderPoolStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    pthread_mutex_lock(&pool->lock);
+    stats->hits      = pool->hits;
+    stats->misses    = pool->misses;
+    stats->evictions = pool->evictions;
+    for (int i = 0; i < pool->nb_entries; i++) {
+        if (pool->entries[i].leased)
+            stats->leased++;
+        else
+            stats->idle++;
+    }
+    stats->open_ms  = pool->misses ? pool->open_us / 1000.0 / pool->misses : 0;
+    stats->reuse_ms = pool->hits ? pool->reuse_us / 1000.0 / pool->hits : 0;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+#endif // __EASY_DECODER_POOL_H__
@@ -15,14 +15,25 @@
 #ifndef __EASY_DISPLAY_H__
 #define __EASY_DISPLAY_H__
 
+#include "easy_audio.h"
 #include "easy_common.h"
+#include "easy_trace.h"
 
 #include <SDL2/SDL.h>
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
 
+#include <math.h>
+#include <string.h>
+
 #define ONESECOND 1000
 
+/* outside of this window the clocks are considered unrelated and not synced */
+#define EASY_AV_NOSYNC_THRESHOLD 10.0
+/* bounds of the tolerated A/V offset before video is corrected */
+#define EASY_AV_SYNC_THRESHOLD_MIN 0.04
+#define EASY_AV_SYNC_THRESHOLD_MAX 0.1
+
 /**
  * Initialize SDL and create a window.
  *
@@ -56,6 +67,8 @@ static inline int easy_init_sdl_for_render(SDL_Window **window, SDL_Renderer **r
  */
 static inline void easy_render_yuv420p(SDL_Renderer **renderer, SDL_Texture **texture, AVFrame *frame, int delay)
 {
+    int64_t trace = easy_trace_begin();
+
     if (!*texture) {
         *texture = SDL_CreateTexture(*renderer, SDL_PIXELFORMAT_IYUV, SDL_TEXTUREACCESS_STREAMING, frame->width, frame->height);
     }
@@ -66,6 +79,7 @@ static inline void easy_render_yuv420p(SDL_Renderer **renderer, SDL_Texture **te
     SDL_RenderClear(*renderer);
     SDL_RenderCopy(*renderer, *texture, NULL, NULL);
     SDL_RenderPresent(*renderer);
+    easy_trace_end(trace, "render");
     SDL_Delay((Uint32)delay);
 }
 
@@ -91,4 +105,327 @@ static inline int easy_sdl_event_in_loop(SDL_Event *event)
     return 0;
 }
 
+/**
+ * SDL audio output fed from a lock-free single-producer single-consumer
+ * ring of interleaved float samples.
+ *
+ * The decoding thread writes with easy_audio_queue_frame(), the SDL audio
+ * callback reads; the only lock is a spinlock around the few words making up
+ * the clock. The audio clock is the master clock for A/V sync.
+ *
+ * @note To run headless (CI, servers), set SDL_AUDIODRIVER=dummy, or
+ *       SDL_AUDIODRIVER=disk to capture the output into a file.
+ */
+typedef struct EasyAudioOutput {
+    SDL_AudioDeviceID dev;
+    SDL_AudioSpec     spec;            ///< format obtained from the device
+
+    float            *ring;
+    int               ring_size;       ///< capacity in floats, a power of two
+    SDL_atomic_t      read_pos;        ///< floats consumed by the callback, wraps around
+    SDL_atomic_t      write_pos;       ///< floats produced by the decoder, wraps around
+
+    SDL_SpinLock      clock_lock;
+    double            write_pts;       ///< pts right after the last queued sample, seconds
+    double            clock_pts;       ///< pts audible at clock_time
+    Uint64            clock_time;      ///< performance counter of the last callback
+
+    SDL_atomic_t      underruns;       ///< callbacks that ran out of samples
+    SDL_atomic_t      silence_samples; ///< sample frames of silence inserted
+    int               started;         ///< the first sample was queued
+
+    float            *convert_buf;     ///< producer side conversion scratch
+    int               convert_size;
+} EasyAudioOutput;
+
+/**
+ * Counters exposed by easy_audio_get_stats().
+ */
+typedef struct EasyAudioStats {
+    int    underruns;       ///< callbacks that ran out of samples
+    int    silence_samples; ///< sample frames of silence inserted
+    double buffered;        ///< seconds queued in the ring
+    double latency;         ///< seconds from queuing a sample to hearing it
+} EasyAudioStats;
+
+static inline int easy_audio_ring_fill(EasyAudioOutput *out)
+{
+    return (int)((unsigned)SDL_AtomicGet(&out->write_pos) - (unsigned)SDL_AtomicGet(&out->read_pos));
+}
+
+/* seconds of audio the device holds after the callback returned */
+static inline double easy_audio_device_delay(const EasyAudioOutput *out)
+{
+    return 2.0 * out->spec.samples / out->spec.freq;
+}
+
+static inline void easy_audio_callback(void *userdata, Uint8 *stream, int len)
+{
+    EasyAudioOutput *out = (EasyAudioOutput *)userdata;
+    float *dst = (float *)stream;
+    int wanted = len / (int)sizeof(float);
+    unsigned r = (unsigned)SDL_AtomicGet(&out->read_pos);
+    unsigned w = (unsigned)SDL_AtomicGet(&out->write_pos);
+    int avail = (int)(w - r);
+    int n = avail < wanted ? avail : wanted;
+    int first = out->ring_size - (int)(r & (out->ring_size - 1));
+    double pts;
+
+    SDL_MemoryBarrierAcquire();
+    if (first > n)
+        first = n;
+    SDL_memcpy(dst, out->ring + (r & (out->ring_size - 1)), first * sizeof(float));
+    SDL_memcpy(dst + first, out->ring, (n - first) * sizeof(float));
+    if (n < wanted) {
+        SDL_memset(dst + n, 0, (wanted - n) * sizeof(float));
+        if (out->started) {
+            SDL_AtomicAdd(&out->underruns, 1);
+            SDL_AtomicAdd(&out->silence_samples, (wanted - n) / out->spec.channels);
+        }
+    }
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&out->read_pos, (int)(r + n));
+
+    SDL_AtomicLock(&out->clock_lock);
+    /* what is still in the ring plays after what was just handed to SDL */
+    pts = out->write_pts - (double)easy_audio_ring_fill(out) / out->spec.channels / out->spec.freq;
+    out->clock_pts  = pts - easy_audio_device_delay(out);
+    out->clock_time = SDL_GetPerformanceCounter();
+    SDL_AtomicUnlock(&out->clock_lock);
+}
+
+/**
+ * Open an SDL audio device playing interleaved float samples.
+ *
+ * @param out The output to initialize.
+ * @param sample_rate The sample rate of the decoded audio.
+ * @param channels The number of channels of the decoded audio.
+ * @param buffer_seconds The capacity of the sample ring in seconds.
+ *
+ * @note The device starts paused, it is unpaused by the first queued frame.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static inline int easy_init_sdl_audio(EasyAudioOutput *out, int sample_rate, int channels, double buffer_seconds)
+{
+    SDL_AudioSpec wanted;
+    int size = 1;
+
+    SDL_memset(out, 0, sizeof(*out));
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO)) {
+        fprintf(stderr, "Couldn't initialize SDL audio - %s\n", SDL_GetError());
+        return -1;
+    }
+
+    while (size < buffer_seconds * sample_rate * channels)
+        size <<= 1;
+    out->ring = (float *)av_malloc(size * sizeof(float));
+    if (!out->ring) {
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return -1;
+    }
+    out->ring_size = size;
+
+    SDL_memset(&wanted, 0, sizeof(wanted));
+    wanted.freq     = sample_rate;
+    wanted.format   = AUDIO_F32SYS;
+    wanted.channels = (Uint8)channels;
+    wanted.samples  = 1024;
+    wanted.callback = easy_audio_callback;
+    wanted.userdata = out;
+
+    /* SDL converts to whatever the hardware wants, the ring stays in the decoded format */
+    out->dev = SDL_OpenAudioDevice(NULL, 0, &wanted, &out->spec, 0);
+    if (!out->dev) {
+        fprintf(stderr, "Failed to open audio device, %s\n", SDL_GetError());
+        av_freep(&out->ring);
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Close the audio device and free the ring.
+ */
+static inline void easy_close_sdl_audio(EasyAudioOutput *out)
+{
+    if (out->dev)
+        SDL_CloseAudioDevice(out->dev);
+    out->dev = 0;
+    av_freep(&out->ring);
+    av_freep(&out->convert_buf);
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+}
+
+/**
+ * Get the free space of the ring in seconds.
+ */
+static inline double easy_audio_free_space(EasyAudioOutput *out)
+{
+    return (double)(out->ring_size - easy_audio_ring_fill(out)) / out->spec.channels / out->spec.freq;
+}
+
+/**
+ * Queue a decoded audio frame for playback. Never blocks.
+ *
+ * @param out The audio output.
+ * @param frame The decoded frame, its rate and channels must match the output.
+ * @param pts The presentation time of the frame in seconds.
+ *
+ * @return 0 on success, AVERROR(EAGAIN) if the ring has no room for the
+ *         frame, a negative AVERROR code on failure.
+ */
+static inline int easy_audio_queue_frame(EasyAudioOutput *out, const AVFrame *frame, double pts)
+{
+    int count = frame->nb_samples * easy_frame_channels(frame);
+    unsigned w = (unsigned)SDL_AtomicGet(&out->write_pos);
+    int first, ret;
+
+    if (easy_frame_channels(frame) != out->spec.channels || frame->sample_rate != out->spec.freq) {
+        av_log(NULL, AV_LOG_ERROR, "Audio frame does not match the output format\n");
+        return AVERROR(EINVAL);
+    }
+    if (out->ring_size - easy_audio_ring_fill(out) < count)
+        return AVERROR(EAGAIN);
+
+    if (out->convert_size < count) {
+        av_freep(&out->convert_buf);
+        out->convert_buf = (float *)av_malloc(count * sizeof(float));
+        if (!out->convert_buf) {
+            out->convert_size = 0;
+            return AVERROR(ENOMEM);
+        }
+        out->convert_size = count;
+    }
+    if ((ret = easy_audio_to_float(frame, out->convert_buf)) < 0)
+        return ret;
+
+    first = out->ring_size - (int)(w & (out->ring_size - 1));
+    if (first > count)
+        first = count;
+    memcpy(out->ring + (w & (out->ring_size - 1)), out->convert_buf, first * sizeof(float));
+    memcpy(out->ring, out->convert_buf + first, (count - first) * sizeof(float));
+    SDL_MemoryBarrierRelease();
+
+    /* publish the samples and their end pts together for the clock */
+    SDL_AtomicLock(&out->clock_lock);
+    SDL_AtomicSet(&out->write_pos, (int)(w + count));
+    out->write_pts = pts + (double)frame->nb_samples / frame->sample_rate;
+    SDL_AtomicUnlock(&out->clock_lock);
+
+    if (!out->started) {
+        out->started = 1;
+        SDL_PauseAudioDevice(out->dev, 0);
+    }
+    return 0;
+}
+
+/**
+ * Get the audio clock, i.e. the pts of the sample currently being heard.
+ *
+ * @return The clock in seconds, NAN before playback started.
+ */
+static inline double easy_audio_clock(EasyAudioOutput *out)
+{
+    double clock;
+
+    SDL_AtomicLock(&out->clock_lock);
+    if (!out->clock_time)
+        clock = NAN;
+    else
+        clock = out->clock_pts + (double)(SDL_GetPerformanceCounter() - out->clock_time) /
+                                 SDL_GetPerformanceFrequency();
+    SDL_AtomicUnlock(&out->clock_lock);
+
+    return clock;
+}
+
+/**
+ * Read the latency and underrun counters of an audio output.
+ */
+static inline void easy_audio_get_stats(EasyAudioOutput *out, EasyAudioStats *stats)
+{
+    stats->underruns       = SDL_AtomicGet(&out->underruns);
+    stats->silence_samples = SDL_AtomicGet(&out->silence_samples);
+    stats->buffered        = (double)easy_audio_ring_fill(out) / out->spec.channels / out->spec.freq;
+    stats->latency         = stats->buffered + easy_audio_device_delay(out);
+}
+
+/**
+ * What to do with a video frame, as decided by easy_av_sync_video().
+ */
+enum EasyAVSyncAction {
+    EASY_SYNC_SHOW, ///< present the frame after the returned delay
+    EASY_SYNC_DROP, ///< the frame is late, skip it
+};
+
+/**
+ * State of the video side of A/V sync.
+ */
+typedef struct EasyAVSync {
+    double  last_pts;      ///< pts of the last presented frame
+    double  last_diff;     ///< last measured video - audio offset in seconds
+    int64_t dropped;       ///< frames dropped because video was late
+    int64_t repeated;      ///< times the previous frame was held longer because video was early
+} EasyAVSync;
+
+/**
+ * Decide when to present a video frame so it follows the audio clock.
+ *
+ * Small offsets are tolerated, a late frame is dropped once video is more
+ * than a frame behind, an early frame is held (the previous one repeats on
+ * screen) until audio catches up. Without an audio clock the frame duration
+ * is used as is.
+ *
+ * @param sync The sync state, zero-initialized before the first frame.
+ * @param audio The master audio output, may be NULL.
+ * @param pts The presentation time of the frame in seconds.
+ * @param duration The nominal duration of a frame in seconds.
+ * @param delay_ms Receives how long to wait before presenting the frame.
+ *
+ * @return EASY_SYNC_SHOW or EASY_SYNC_DROP.
+ */
+static inline enum EasyAVSyncAction easy_av_sync_video(EasyAVSync *sync, EasyAudioOutput *audio,
+                                                       double pts, double duration, Uint32 *delay_ms)
+{
+    double clock = audio ? easy_audio_clock(audio) : NAN;
+    double threshold = duration;
+    double diff, delay;
+
+    if (threshold < EASY_AV_SYNC_THRESHOLD_MIN)
+        threshold = EASY_AV_SYNC_THRESHOLD_MIN;
+    if (threshold > EASY_AV_SYNC_THRESHOLD_MAX)
+        threshold = EASY_AV_SYNC_THRESHOLD_MAX;
+
+    *delay_ms = 0;
+    if (isnan(clock)) {
+        /* no master clock yet, pace by the frame duration */
+        *delay_ms = (Uint32)(duration * ONESECOND);
+        sync->last_pts = pts;
+        return EASY_SYNC_SHOW;
+    }
+
+    diff = pts - clock;
+    sync->last_diff = diff;
+    if (fabs(diff) > EASY_AV_NOSYNC_THRESHOLD) {
+        delay = duration;
+    } else if (diff <= -threshold) {
+        if (diff < -duration) {
+            sync->dropped++;
+            return EASY_SYNC_DROP;
+        }
+        delay = 0;
+    } else if (diff >= threshold) {
+        sync->repeated++;
+        delay = diff;
+    } else {
+        delay = diff > 0 ? diff : 0;
+    }
+
+    *delay_ms = (Uint32)(delay * ONESECOND);
+    sync->last_pts = pts;
+    return EASY_SYNC_SHOW;
+}
+
 #endif // __EASY_DISPLAY_H__
\ No newline at end of file
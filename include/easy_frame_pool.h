@@ -0,0 +1,391 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_FRAME_POOL_H__
+#define __EASY_FRAME_POOL_H__
+
+#include "easy_common.h"
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/version.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#define EASY_FRAME_POOL_MAX_GEOMETRIES 32
+#define EASY_FRAME_POOL_ALIGN          64
+#define EASY_FRAME_POOL_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/* back planes with transparent huge pages where the kernel supports it */
+#define EASY_FRAME_POOL_FLAG_HUGEPAGES (1 << 0)
+/* touch every page on allocation so decoding never takes a page fault */
+#define EASY_FRAME_POOL_FLAG_PREFAULT  (1 << 1)
+
+#if LIBAVUTIL_VERSION_MAJOR < 57
+typedef int easy_buffer_size_t;
+#else
+typedef size_t easy_buffer_size_t;
+#endif
+
+/**
+ * The buffer pools serving one frame geometry.
+ */
+typedef struct EasyFramePoolGeometry {
+    enum AVCodecID     codec_id;
+    enum AVPixelFormat format;
+    int                width;
+    int                height;
+    int                nb_planes;
+    int                linesize[4];
+    AVBufferPool      *pools[4];
+    uint64_t           last_used; ///< value of the pool clock at the last request
+    int                busy;      ///< get_buffer2() calls taking buffers from pools right now
+} EasyFramePoolGeometry;
+
+/**
+ * A frame buffer allocator shared by any number of decoders.
+ *
+ * Planes are served from one AVBufferPool per plane and frame geometry, so
+ * once a decoder has warmed up, decoding a frame does not touch the system
+ * allocator at all.
+ *
+ * At most EASY_FRAME_POOL_MAX_GEOMETRIES geometries are kept. A new one
+ * replaces the least recently used: its pools are released, frames still
+ * holding their buffers stay valid and free them on release.
+ */
+typedef struct EasyFramePool {
+    pthread_mutex_t       lock;
+    int                   flags;
+    int                   nb_geometries;
+    EasyFramePoolGeometry geometries[EASY_FRAME_POOL_MAX_GEOMETRIES];
+    uint64_t              clock;
+
+
+    /* statistics, protected by lock */
+    uint64_t              requests;
+    uint64_t              misses;
+    uint64_t              fallbacks;
+    uint64_t              evictions;
+    int64_t               resident_bytes;
+    int64_t               peak_resident_bytes;
+} EasyFramePool;
+
+/**
+ * Counters exposed by easy_frame_pool_get_stats().
+ */
+typedef struct EasyFramePoolStats {
+    uint64_t hits;                ///< planes served from a pool
+    uint64_t misses;              ///< planes that needed a fresh allocation
+    uint64_t fallbacks;           ///< frames handed to FFmpeg's default allocator
+    uint64_t evictions;           ///< geometries dropped to make room for a new one
+    int64_t  resident_bytes;      ///< bytes currently allocated by the pools
+    int64_t  peak_resident_bytes; ///< highest value of resident_bytes
+} EasyFramePoolStats;
+
+/* One allocation made by a pool. */
+typedef struct EasyFramePoolChunk {
+    EasyFramePool *pool;
+    size_t         size;
+} EasyFramePoolChunk;
+
+/**
+ * Allocate a frame pool.
+ *
+ * @param pool A pointer to a pointer to an EasyFramePool, which will be allocated and initialized.
+ * @param flags A combination of EASY_FRAME_POOL_FLAG_* values.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_frame_pool_alloc(EasyFramePool **pool, int flags)
+{
+    *pool = (EasyFramePool *)av_mallocz(sizeof(**pool));
+    if (!*pool)
+        return AVERROR(ENOMEM);
+    if (pthread_mutex_init(&(*pool)->lock, NULL)) {
+        av_freep(pool);
+        return AVERROR(ENOMEM);
+    }
+    (*pool)->flags = flags;
+    return 0;
+}
+
+/**
+ * Free a frame pool and set the pointer to NULL.
+ *
+ * @note Every decoder using the pool must be closed and every frame it
+ *       produced released before this call.
+ */
+static inline void easy_frame_pool_free(EasyFramePool **pool)
+{
+    if (!*pool)
+        return;
+    for (int i = 0; i < (*pool)->nb_geometries; i++)
+        for (int p = 0; p < 4; p++)
+            av_buffer_pool_uninit(&(*pool)->geometries[i].pools[p]);
+    pthread_mutex_destroy(&(*pool)->lock);
+    av_freep(pool);
+}
+
+/**
+ * Read the allocation counters of a frame pool.
+ */
+static inline void easy_frame_pool_get_stats(EasyFramePool *pool, EasyFramePoolStats *stats)
+{
+    pthread_mutex_lock(&pool->lock);
+    stats->hits                = pool->requests - pool->misses;
+    stats->misses              = pool->misses;
+    stats->fallbacks           = pool->fallbacks;
+    stats->evictions           = pool->evictions;
+    stats->resident_bytes      = pool->resident_bytes;
+    stats->peak_resident_bytes = pool->peak_resident_bytes;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static inline void easy_frame_pool_chunk_free(void *opaque, uint8_t *data)
+{
+    EasyFramePoolChunk *chunk = (EasyFramePoolChunk *)opaque;
+
+    pthread_mutex_lock(&chunk->pool->lock);
+    chunk->pool->resident_bytes -= chunk->size;
+    pthread_mutex_unlock(&chunk->pool->lock);
+
+#ifdef _WIN32
+    av_free(data);
+#else
+    free(data);
+#endif
+    av_free(chunk);
+}
+
+/* Called by AVBufferPool when it has no free buffer left, i.e. on a miss. */
+static inline AVBufferRef *easy_frame_pool_chunk_alloc(void *opaque, easy_buffer_size_t size)
+{
+    EasyFramePool *pool = (EasyFramePool *)opaque;
+    EasyFramePoolChunk *chunk;
+    AVBufferRef *buf;
+    uint8_t *data = NULL;
+    size_t align = EASY_FRAME_POOL_ALIGN;
+
+    chunk = (EasyFramePoolChunk *)av_malloc(sizeof(*chunk));
+    if (!chunk)
+        return NULL;
+
+#ifdef _WIN32
+    data = (uint8_t *)av_malloc(size);
+#else
+    if ((pool->flags & EASY_FRAME_POOL_FLAG_HUGEPAGES) && size >= EASY_FRAME_POOL_HUGE_PAGE_SIZE) {
+        align = EASY_FRAME_POOL_HUGE_PAGE_SIZE;
+    }
+    /* C11 and C++17 declare aligned_alloc() without any feature macro, unlike
+     * posix_memalign(), and it wants the size to be a multiple of the alignment */
+    size = FFALIGN(size, align);
+    data = (uint8_t *)aligned_alloc(align, size);
+#endif
+    if (!data) {
+        av_free(chunk);
+        return NULL;
+    }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (align == EASY_FRAME_POOL_HUGE_PAGE_SIZE)
+        madvise(data, size, MADV_HUGEPAGE);
+#endif
+    if (pool->flags & EASY_FRAME_POOL_FLAG_PREFAULT)
+        memset(data, 0, size);
+
+    chunk->pool = pool;
+    chunk->size = size;
+    buf = av_buffer_create(data, size, easy_frame_pool_chunk_free, chunk, 0);
+    if (!buf) {
+#ifdef _WIN32
+        av_free(data);
+#else
+        free(data);
+#endif
+        av_free(chunk);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->misses++;
+    pool->resident_bytes += size;
+    if (pool->resident_bytes > pool->peak_resident_bytes)
+        pool->peak_resident_bytes = pool->resident_bytes;
+    pthread_mutex_unlock(&pool->lock);
+
+    return buf;
+}
+
+/*
+ * Find or create the pools for a frame geometry, must be called with the pool
+ * lock held. The plane layout follows what avcodec_default_get_buffer2() does
+ * so decoders see the same padding and stride alignment they expect.
+ */
+static inline EasyFramePoolGeometry *easy_frame_pool_get_geometry(EasyFramePool *pool, AVCodecContext *avctx,
+                                                                  const AVFrame *frame)
+{
+    EasyFramePoolGeometry *geo;
+    int w = frame->width, h = frame->height;
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    uint8_t *data[4];
+    ptrdiff_t total;
+    int unaligned;
+
+    for (int i = 0; i < pool->nb_geometries; i++) {
+        geo = &pool->geometries[i];
+        if (geo->pools[0] && geo->codec_id == avctx->codec_id && geo->format == frame->format &&
+            geo->width == frame->width && geo->height == frame->height) {
+            geo->last_used = ++pool->clock;
+            return geo;
+        }
+    }
+
+    if (pool->nb_geometries < EASY_FRAME_POOL_MAX_GEOMETRIES) {
+        geo = &pool->geometries[pool->nb_geometries];
+    } else {
+        /* evict the least recently used geometry nobody is taking buffers
+         * from, uninit leaves the buffers frames still hold alive. A slot
+         * whose setup failed has last_used 0 and goes first. */
+        geo = NULL;
+        for (int i = 0; i < pool->nb_geometries; i++) {
+            EasyFramePoolGeometry *g = &pool->geometries[i];
+            if (!g->busy && (!geo || g->last_used < geo->last_used))
+                geo = g;
+        }
+        if (!geo)
+            return NULL;
+        for (int p = 0; p < 4; p++)
+            av_buffer_pool_uninit(&geo->pools[p]);
+        if (geo->last_used)
+            pool->evictions++;
+    }
+    memset(geo, 0, sizeof(*geo));
+
+    avcodec_align_dimensions2(avctx, &w, &h, linesize_align);
+    do {
+        /* increase the width until every linesize matches the alignment the
+         * decoder needs as well as our own SIMD alignment */
+        if (av_image_fill_linesizes(geo->linesize, (enum AVPixelFormat)frame->format, w) < 0)
+            return NULL;
+        w += w & ~(w - 1);
+        unaligned = 0;
+        for (int i = 0; i < 4; i++)
+            unaligned |= geo->linesize[i] % FFMAX(linesize_align[i], EASY_FRAME_POOL_ALIGN);
+    } while (unaligned);
+
+    total = av_image_fill_pointers(data, (enum AVPixelFormat)frame->format, h, NULL, geo->linesize);
+    if (total < 0)
+        return NULL;
+
+    geo->nb_planes = av_pix_fmt_count_planes((enum AVPixelFormat)frame->format);
+    for (int i = 0; i < geo->nb_planes; i++) {
+        size_t size = i + 1 < geo->nb_planes ? (size_t)(data[i + 1] - data[i])
+                                             : (size_t)(total - (data[i] - data[0]));
+
+        /* chunks are already aligned, only the decoder overread padding is added */
+        geo->pools[i] = av_buffer_pool_init2(size + 16, pool,
+                                             easy_frame_pool_chunk_alloc, NULL);
+        if (!geo->pools[i]) {
+            for (int p = 0; p < i; p++)
+                av_buffer_pool_uninit(&geo->pools[p]);
+            return NULL;
+        }
+    }
+
+    geo->codec_id  = avctx->codec_id;
+    geo->format    = (enum AVPixelFormat)frame->format;
+    geo->width     = frame->width;
+    geo->height    = frame->height;
+    geo->last_used = ++pool->clock;
+    if (geo == &pool->geometries[pool->nb_geometries])
+        pool->nb_geometries++;
+
+    return geo;
+}
+
+/**
+ * get_buffer2() callback serving frames from the EasyFramePool stored in
+ * avctx->opaque. Frames the pool cannot serve (hardware frames, palettes,
+ * audio, every geometry busy) are passed to avcodec_default_get_buffer2().
+ */
+static inline int easy_frame_pool_get_buffer2(AVCodecContext *avctx, AVFrame *frame, int flags)
+{
+    EasyFramePool *pool = (EasyFramePool *)avctx->opaque;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+    EasyFramePoolGeometry *geo = NULL;
+    int nb_planes = 0;
+
+    if (avctx->codec_type == AVMEDIA_TYPE_VIDEO && desc &&
+        !(desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))) {
+        pthread_mutex_lock(&pool->lock);
+        geo = easy_frame_pool_get_geometry(pool, avctx, frame);
+        if (geo) {
+            nb_planes = geo->nb_planes;
+            pool->requests += nb_planes;
+            geo->busy++;
+        } else {
+            pool->fallbacks++;
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+    if (!geo)
+        return avcodec_default_get_buffer2(avctx, frame, flags);
+
+    /* the lock is not held here, a miss takes it in easy_frame_pool_chunk_alloc(),
+     * busy keeps the geometry from being evicted meanwhile */
+    for (int i = 0; i < nb_planes; i++) {
+        frame->buf[i] = av_buffer_pool_get(geo->pools[i]);
+        if (!frame->buf[i])
+            break;
+        frame->data[i]     = frame->buf[i]->data;
+        frame->linesize[i] = geo->linesize[i];
+    }
+    frame->extended_data = frame->data;
+
+    pthread_mutex_lock(&pool->lock);
+    geo->busy--;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!frame->buf[nb_planes - 1]) {
+        av_frame_unref(frame);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+/**
+ * Make a decoder allocate its frames from a frame pool. Must be called
+ * before avcodec_open2(), the pool is stored in avctx->opaque.
+ *
+ * @param avctx The decoder context.
+ * @param pool The pool to share, it must outlive the decoder and its frames.
+ */
+static inline void easy_frame_pool_install(AVCodecContext *avctx, EasyFramePool *pool)
+{
+    if (avctx->codec && !(avctx->codec->capabilities & AV_CODEC_CAP_DR1)) {
+        av_log(NULL, AV_LOG_VERBOSE, "Decoder %s does not support custom buffers\n", avctx->codec->name);
+        return;
+    }
+    avctx->opaque      = pool;
+    avctx->get_buffer2 = easy_frame_pool_get_buffer2;
+}
+
+#endif // __EASY_FRAME_POOL_H__
@@ -0,0 +1,571 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_FRAMESTATS_H__
+#define __EASY_FRAMESTATS_H__
+
+#include "easy_common.h"
+#include "easy_kernels.h"
+#include "easy_thread.h"
+#include "easy_trace.h"
+
+#include <libavutil/frame.h>
+#include <libavutil/mem.h>
+#include <libavutil/pixdesc.h>
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define EASY_FRAMESTATS_BINS    256  // samples above 8 bits are scaled down to 8 bits
+#define EASY_FRAMESTATS_VERSION 1
+
+/* frames queued per thread before a batch is analyzed */
+#define EASY_FRAMESTATS_BATCH_PER_THREAD 4
+
+/* defaults in the spirit of the blackdetect and freezedetect filters */
+#define EASY_FRAMESTATS_DEFAULT_BLACK_LEVEL 0.10 // fraction of the luma range
+#define EASY_FRAMESTATS_DEFAULT_BLACK_RATIO 0.98
+#define EASY_FRAMESTATS_DEFAULT_FROZEN_SAD  0.5  // mean absolute luma difference, 0-255
+
+/**
+ * Per-frame statistics, one array per column and one row per frame.
+ *
+ * Values are on an 8-bit scale whatever the bit depth of the frames, planes
+ * are indexed Y, U, V. Gray frames leave the U and V columns at zero.
+ */
+typedef struct EasyFrameStatsTable {
+    int       nb_frames;
+    int       nb_allocated;
+    double   *time;          ///< seconds, NAN for frames without timestamp
+    float    *mean[3];
+    float    *variance[3];
+    uint8_t  *min[3];
+    uint8_t  *max[3];
+    float    *clip_low;      ///< fraction of luma samples at or below black (16, or 0 for full range)
+    float    *clip_high;     ///< fraction of luma samples at or above white (235, or 255 for full range)
+    float    *sad;           ///< mean absolute luma difference to the previous frame, -1 if not comparable
+    uint8_t  *black;
+    uint8_t  *frozen;        ///< a freeze is a run of frozen frames, judge its length yourself
+    uint32_t *hist;          ///< with keep_histograms, 3 x EASY_FRAMESTATS_BINS per frame
+} EasyFrameStatsTable;
+
+/**
+ * Computes statistics of decoded YUV frames straight from their planes.
+ *
+ * Frames are referenced into a batch and analyzed one job per frame on a
+ * worker pool once the batch is full, so a QC job keeps decoding on one
+ * thread while the others scan frames. Each plane is read once into a
+ * histogram, mean, variance, extremes and clipping all follow from it.
+ */
+typedef struct EasyFrameStats {
+    EasyFrameStatsTable table;
+
+    /* thresholds, may be changed between easy_framestats_init() and the first frame */
+    double          black_level;      ///< luma at or below this fraction of the range is black
+    double          black_ratio;      ///< frames with at least this fraction of black luma are black
+    double          frozen_sad;       ///< frames at most this different from the previous are frozen
+    int             keep_histograms;  ///< also store the histograms in the table
+
+    EasyWorkerPool  pool;
+    AVFrame       **batch;
+    double         *batch_time;
+    int             nb_batch;
+    int             max_batch;
+    AVFrame        *prev;             ///< last frame of the previous batch, for the difference
+} EasyFrameStats;
+
+/**
+ * Release a statistics context, its frames and its table.
+ */
+static inline void easy_framestats_uninit(EasyFrameStats *fs)
+{
+    EasyFrameStatsTable *t = &fs->table;
+
+    for (int i = 0; fs->batch && i < fs->nb_batch; i++)
+        av_frame_free(&fs->batch[i]);
+    av_freep(&fs->batch);
+    av_freep(&fs->batch_time);
+    av_frame_free(&fs->prev);
+    easy_worker_pool_uninit(&fs->pool);
+
+    av_freep(&t->time);
+    for (int p = 0; p < 3; p++) {
+        av_freep(&t->mean[p]);
+        av_freep(&t->variance[p]);
+        av_freep(&t->min[p]);
+        av_freep(&t->max[p]);
+    }
+    av_freep(&t->clip_low);
+    av_freep(&t->clip_high);
+    av_freep(&t->sad);
+    av_freep(&t->black);
+    av_freep(&t->frozen);
+    av_freep(&t->hist);
+    memset(t, 0, sizeof(*t));
+}
+
+/**
+ * Initialize a statistics context with the default thresholds.
+ *
+ * @param fs The context to initialize.
+ * @param nb_threads The number of threads analyzing frames, <= 0 for one per CPU.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_framestats_init(EasyFrameStats *fs, int nb_threads)
+{
+    int ret;
+
+    memset(fs, 0, sizeof(*fs));
+    fs->black_level = EASY_FRAMESTATS_DEFAULT_BLACK_LEVEL;
+    fs->black_ratio = EASY_FRAMESTATS_DEFAULT_BLACK_RATIO;
+    fs->frozen_sad  = EASY_FRAMESTATS_DEFAULT_FROZEN_SAD;
+
+    if ((ret = easy_worker_pool_init(&fs->pool, nb_threads)) < 0)
+        return ret;
+    fs->max_batch  = fs->pool.nb_threads * EASY_FRAMESTATS_BATCH_PER_THREAD;
+    fs->batch      = (AVFrame **)av_calloc(fs->max_batch, sizeof(*fs->batch));
+    fs->batch_time = (double *)av_calloc(fs->max_batch, sizeof(*fs->batch_time));
+    if (!fs->batch || !fs->batch_time) {
+        easy_framestats_uninit(fs);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+/* grow one column, the old array stays valid on failure */
+static inline int easy_framestats_grow_column(void *column, int nb, size_t size)
+{
+    void *p = av_realloc_array(*(void **)column, nb, size);
+
+    if (!p)
+        return AVERROR(ENOMEM);
+    *(void **)column = p;
+    return 0;
+}
+
+static inline int easy_framestats_table_grow(EasyFrameStatsTable *t, int nb_frames, int keep_histograms)
+{
+    int nb = nb_frames <= t->nb_allocated ? t->nb_allocated : FFMAX(nb_frames, t->nb_allocated * 2);
+    int ret = 0;
+
+    if (nb == t->nb_allocated && (!keep_histograms || t->hist))
+        return 0;
+    ret = FFMIN(ret, easy_framestats_grow_column(&t->time, nb, sizeof(*t->time)));
+    for (int p = 0; p < 3; p++) {
+        ret = FFMIN(ret, easy_framestats_grow_column(&t->mean[p], nb, sizeof(*t->mean[p])));
+        ret = FFMIN(ret, easy_framestats_grow_column(&t->variance[p], nb, sizeof(*t->variance[p])));
+        ret = FFMIN(ret, easy_framestats_grow_column(&t->min[p], nb, sizeof(*t->min[p])));
+        ret = FFMIN(ret, easy_framestats_grow_column(&t->max[p], nb, sizeof(*t->max[p])));
+    }
+    ret = FFMIN(ret, easy_framestats_grow_column(&t->clip_low, nb, sizeof(*t->clip_low)));
+    ret = FFMIN(ret, easy_framestats_grow_column(&t->clip_high, nb, sizeof(*t->clip_high)));
+    ret = FFMIN(ret, easy_framestats_grow_column(&t->sad, nb, sizeof(*t->sad)));
+    ret = FFMIN(ret, easy_framestats_grow_column(&t->black, nb, sizeof(*t->black)));
+    ret = FFMIN(ret, easy_framestats_grow_column(&t->frozen, nb, sizeof(*t->frozen)));
+    if (keep_histograms && ret >= 0) {
+        int had = !!t->hist;
+        ret = easy_framestats_grow_column(&t->hist, nb, 3 * EASY_FRAMESTATS_BINS * sizeof(*t->hist));
+        /* frames analyzed before keep_histograms was set have none */
+        if (ret >= 0 && !had)
+            memset(t->hist, 0, (size_t)t->nb_frames * 3 * EASY_FRAMESTATS_BINS * sizeof(*t->hist));
+    }
+    if (ret < 0)
+        return ret;
+    t->nb_allocated = nb;
+    return 0;
+}
+
+/**
+ * Add the histogram of an 8-bit plane or of one component of an
+ * interleaved plane (e.g. U or V of NV12) to hist.
+ *
+ * @param data The first sample.
+ * @param linesize The number of bytes in a row.
+ * @param width The number of samples in a row.
+ * @param height The number of rows.
+ * @param step The distance in bytes between two samples, 1 for planar.
+ * @param hist The EASY_FRAMESTATS_BINS counters to add to.
+ */
+static inline void easy_framestats_hist_plane(const uint8_t *data, int linesize, int width, int height, int step,
+                                              uint32_t *hist)
+{
+    /* consecutive equal samples would serialize on one counter, spread them over four */
+    uint32_t sub[4][EASY_FRAMESTATS_BINS];
+
+    memset(sub, 0, sizeof(sub));
+    for (int j = 0; j < height; j++) {
+        const uint8_t *row = data + (ptrdiff_t)j * linesize;
+        int i = 0;
+
+        if (step == 1) {
+            /* one load per 8 samples instead of one per sample */
+            for (; i + 8 <= width; i += 8) {
+                uint64_t v;
+                memcpy(&v, row + i, sizeof(v));
+                sub[0][v & 0xff]++;
+                sub[1][(v >> 8) & 0xff]++;
+                sub[2][(v >> 16) & 0xff]++;
+                sub[3][(v >> 24) & 0xff]++;
+                sub[0][(v >> 32) & 0xff]++;
+                sub[1][(v >> 40) & 0xff]++;
+                sub[2][(v >> 48) & 0xff]++;
+                sub[3][v >> 56]++;
+            }
+        }
+        for (; i < width; i++)
+            sub[i & 3][row[(ptrdiff_t)i * step]]++;
+    }
+    for (int v = 0; v < EASY_FRAMESTATS_BINS; v++)
+        hist[v] += sub[0][v] + sub[1][v] + sub[2][v] + sub[3][v];
+}
+
+/**
+ * Like easy_framestats_hist_plane() for little-endian samples of 9 to 16
+ * bits, scaled down to 8 bits.
+ *
+ * @param shift The number of low bits to drop, from AVComponentDescriptor.shift.
+ * @param depth The number of significant bits.
+ */
+static inline void easy_framestats_hist_plane16(const uint8_t *data, int linesize, int width, int height, int step,
+                                                int shift, int depth, uint32_t *hist)
+{
+    uint32_t sub[2][EASY_FRAMESTATS_BINS];
+    int down = shift + depth - 8;
+
+    memset(sub, 0, sizeof(sub));
+    for (int j = 0; j < height; j++) {
+        const uint8_t *row = data + (ptrdiff_t)j * linesize;
+
+        for (int i = 0; i < width; i++) {
+            uint16_t v;
+            memcpy(&v, row + (ptrdiff_t)i * step, sizeof(v));
+            sub[i & 1][(v >> down) & 0xff]++;
+        }
+    }
+    for (int v = 0; v < EASY_FRAMESTATS_BINS; v++)
+        hist[v] += sub[0][v] + sub[1][v];
+}
+
+/* mean absolute difference of two 8-bit planes, 16 samples at a time */
+static inline uint64_t easy_framestats_sad8(const uint8_t *a, int a_linesize, const uint8_t *b, int b_linesize,
+                                            int width, int height)
+{
+#if defined(EASY_HAVE_KERNELS)
+    return easy_kernel_sad_plane(a, a_linesize, b, b_linesize, width, height);
+#else
+    uint64_t total = 0;
+
+    for (int j = 0; j < height; j++) {
+        const uint8_t *ra = a + (ptrdiff_t)j * a_linesize;
+        const uint8_t *rb = b + (ptrdiff_t)j * b_linesize;
+        int i = 0;
+
+#if defined(__SSE2__)
+        __m128i sum = _mm_setzero_si128();
+        for (; i + 16 <= width; i += 16)
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(ra + i)),
+                                                  _mm_loadu_si128((const __m128i *)(rb + i))));
+        total += (uint64_t)_mm_cvtsi128_si32(sum) + (uint64_t)_mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+#endif
+        for (; i < width; i++)
+            total += ra[i] > rb[i] ? ra[i] - rb[i] : rb[i] - ra[i];
+    }
+    return total;
+#endif
+}
+
+static inline uint64_t easy_framestats_sad16(const uint8_t *a, int a_linesize, const uint8_t *b, int b_linesize,
+                                             int width, int height, int shift)
+{
+    uint64_t total = 0;
+
+    for (int j = 0; j < height; j++) {
+        const uint16_t *ra = (const uint16_t *)(a + (ptrdiff_t)j * a_linesize);
+        const uint16_t *rb = (const uint16_t *)(b + (ptrdiff_t)j * b_linesize);
+
+        for (int i = 0; i < width; i++) {
+            int d = (ra[i] >> shift) - (rb[i] >> shift);
+            total += d < 0 ? -d : d;
+        }
+    }
+    return total;
+}
+
+/* YUV or gray, little-endian, luma in its own plane with one sample per step */
+static inline int easy_framestats_supported(const AVPixFmtDescriptor *desc)
+{
+    return desc && !(desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM |
+                                    AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BE)) &&
+           desc->comp[0].depth >= 8 && desc->comp[0].depth <= 16 &&
+           desc->comp[0].step == (desc->comp[0].depth > 8 ? 2 : 1);
+}
+
+static inline int easy_framestats_job(void *opaque, int job, int worker)
+{
+    EasyFrameStats *fs = (EasyFrameStats *)opaque;
+    EasyFrameStatsTable *t = &fs->table;
+    const AVFrame *frame = fs->batch[job];
+    const AVFrame *prev = job ? fs->batch[job - 1] : fs->prev;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+    int row = t->nb_frames + job;
+    int nb_planes = desc->nb_components >= 3 ? 3 : 1;
+    int full = frame->color_range == AVCOL_RANGE_JPEG || frame->format == AV_PIX_FMT_YUVJ420P ||
+               frame->format == AV_PIX_FMT_YUVJ422P || frame->format == AV_PIX_FMT_YUVJ444P;
+    int black = full ? 0 : 16, white = full ? 255 : 235;
+    int black_max = black + (int)(fs->black_level * (white - black));
+    uint32_t hist[3][EASY_FRAMESTATS_BINS];
+    uint64_t n = 0, low = 0, high = 0, dark = 0;
+    (void)worker;
+
+    memset(hist, 0, sizeof(hist));
+    t->time[row] = fs->batch_time[job];
+    for (int p = 0; p < 3; p++) {
+        t->mean[p][row] = t->variance[p][row] = 0;
+        t->min[p][row]  = t->max[p][row] = 0;
+    }
+
+    for (int p = 0; p < nb_planes; p++) {
+        const AVComponentDescriptor *c = &desc->comp[p];
+        int w = p ? AV_CEIL_RSHIFT(frame->width, desc->log2_chroma_w) : frame->width;
+        int h = p ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+        const uint8_t *data = frame->data[c->plane] + c->offset;
+        uint64_t sum = 0, sumsq = 0, count = (uint64_t)w * h;
+        int min = -1, max = 0;
+        double mean;
+
+        if (c->depth > 8)
+            easy_framestats_hist_plane16(data, frame->linesize[c->plane], w, h, c->step, c->shift, c->depth,
+                                         hist[p]);
+        else
+            easy_framestats_hist_plane(data, frame->linesize[c->plane], w, h, c->step, hist[p]);
+
+        for (int v = 0; v < EASY_FRAMESTATS_BINS; v++) {
+            if (!hist[p][v])
+                continue;
+            if (min < 0)
+                min = v;
+            max    = v;
+            sum   += (uint64_t)v * hist[p][v];
+            sumsq += (uint64_t)v * v * hist[p][v];
+        }
+        if (!count)
+            continue;
+        mean = (double)sum / count;
+        t->mean[p][row]     = (float)mean;
+        t->variance[p][row] = (float)FFMAX(0.0, (double)sumsq / count - mean * mean);
+        t->min[p][row]      = (uint8_t)FFMAX(min, 0);
+        t->max[p][row]      = (uint8_t)max;
+    }
+
+    for (int v = 0; v < EASY_FRAMESTATS_BINS; v++) {
+        n += hist[0][v];
+        if (v <= black)
+            low += hist[0][v];
+        if (v >= white)
+            high += hist[0][v];
+        if (v <= black_max)
+            dark += hist[0][v];
+    }
+    t->clip_low[row]  = n ? (float)low / n : 0;
+    t->clip_high[row] = n ? (float)high / n : 0;
+    t->black[row]     = n && dark >= fs->black_ratio * n;
+
+    t->sad[row]    = -1;
+    t->frozen[row] = 0;
+    if (prev && prev->format == frame->format && prev->width == frame->width && prev->height == frame->height && n) {
+        const AVComponentDescriptor *c = &desc->comp[0];
+        uint64_t sad;
+
+        if (c->depth > 8)
+            sad = easy_framestats_sad16(frame->data[0], frame->linesize[0], prev->data[0], prev->linesize[0],
+                                        frame->width, frame->height, c->shift);
+        else
+            sad = easy_framestats_sad8(frame->data[0], frame->linesize[0], prev->data[0], prev->linesize[0],
+                                       frame->width, frame->height);
+        t->sad[row]    = (float)((double)sad / n / (1 << (c->depth - 8)));
+        t->frozen[row] = t->sad[row] <= fs->frozen_sad;
+    }
+
+    if (t->hist)
+        memcpy(t->hist + (size_t)row * 3 * EASY_FRAMESTATS_BINS, hist, sizeof(hist));
+    return 0;
+}
+
+/**
+ * Analyze the queued frames now instead of waiting for the batch to fill.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_framestats_flush(EasyFrameStats *fs)
+{
+    int ret;
+
+    if (!fs->nb_batch)
+        return 0;
+    if ((ret = easy_framestats_table_grow(&fs->table, fs->table.nb_frames + fs->nb_batch,
+                                          fs->keep_histograms)) < 0)
+        return ret;
+    EASY_TRACE_CALL("framestats", ret = easy_worker_pool_execute(&fs->pool, easy_framestats_job, fs,
+                                                                 fs->nb_batch));
+    if (ret < 0)
+        return ret;
+
+    fs->table.nb_frames += fs->nb_batch;
+    av_frame_free(&fs->prev);
+    fs->prev = fs->batch[fs->nb_batch - 1];
+    for (int i = 0; i < fs->nb_batch - 1; i++)
+        av_frame_free(&fs->batch[i]);
+    fs->batch[fs->nb_batch - 1] = NULL;
+    fs->nb_batch = 0;
+    return 0;
+}
+
+/**
+ * Queue a decoded frame, the batch is analyzed once it is full.
+ *
+ * Planar and semi-planar YUV and gray formats of 8 to 16 bits are
+ * supported. The frame is referenced, not copied, so decoders with a fixed
+ * number of buffers may need a pool of at least the batch size
+ * (EASY_FRAMESTATS_BATCH_PER_THREAD frames per thread) plus their own.
+ *
+ * @param fs The statistics context.
+ * @param frame The frame, the caller keeps its own reference.
+ * @param time_base The time base of the frame timestamps.
+ *
+ * @return 0 on success, a negative AVERROR code on failure. If the analysis
+ *         of a full batch fails, the batch stays queued and the next call or
+ *         easy_framestats_flush() retries it.
+ */
+static inline int easy_framestats_add(EasyFrameStats *fs, const AVFrame *frame, AVRational time_base)
+{
+    int64_t pts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+    int ret;
+
+    if (!easy_framestats_supported(av_pix_fmt_desc_get((enum AVPixelFormat)frame->format))) {
+        av_log(NULL, AV_LOG_ERROR, "Unsupported pixel format for frame statistics\n");
+        return AVERROR(EINVAL);
+    }
+    /* a batch left full by a failed flush is retried before anything is queued */
+    if (fs->nb_batch == fs->max_batch && (ret = easy_framestats_flush(fs)) < 0)
+        return ret;
+    if (!(fs->batch[fs->nb_batch] = av_frame_clone(frame)))
+        return AVERROR(ENOMEM);
+    fs->batch_time[fs->nb_batch++] = pts != AV_NOPTS_VALUE ? pts * av_q2d(time_base) : NAN;
+
+    return fs->nb_batch == fs->max_batch ? easy_framestats_flush(fs) : 0;
+}
+
+/**
+ * Write the table as CSV, one line per frame, histograms excluded.
+ *
+ * @note Call easy_framestats_flush() first so that queued frames are included.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_framestats_write_csv(const EasyFrameStats *fs, const char *filename)
+{
+    const EasyFrameStatsTable *t = &fs->table;
+    FILE *f;
+    int ret = 0;
+
+    if (!(f = fopen(filename, "w"))) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open %s\n", filename);
+        return AVERROR(errno);
+    }
+    fprintf(f, "frame,time,y_mean,y_variance,y_min,y_max,u_mean,u_variance,u_min,u_max,"
+               "v_mean,v_variance,v_min,v_max,clip_low,clip_high,sad,black,frozen\n");
+    for (int i = 0; i < t->nb_frames; i++) {
+        fprintf(f, "%d,%.6f", i, t->time[i]);
+        for (int p = 0; p < 3; p++)
+            fprintf(f, ",%.3f,%.3f,%d,%d", t->mean[p][i], t->variance[p][i], t->min[p][i], t->max[p][i]);
+        fprintf(f, ",%.6f,%.6f,%.4f,%d,%d\n", t->clip_low[i], t->clip_high[i], t->sad[i], t->black[i],
+                t->frozen[i]);
+    }
+    if (ferror(f))
+        ret = AVERROR(EIO);
+    if (fclose(f) && ret >= 0)
+        ret = AVERROR(EIO);
+    if (ret < 0)
+        av_log(NULL, AV_LOG_ERROR, "Cannot write %s\n", filename);
+    return ret;
+}
+
+typedef struct EasyFrameStatsHeader {
+    char     magic[4];      ///< "EFST"
+    int32_t  version;
+    int32_t  nb_frames;
+    int32_t  has_histograms;
+} EasyFrameStatsHeader;
+
+/**
+ * Write the table in native byte order, column after column as laid out in
+ * EasyFrameStatsTable: time, mean[3], variance[3], min[3], max[3],
+ * clip_low, clip_high, sad, black, frozen, then the histograms if kept.
+ *
+ * @note Call easy_framestats_flush() first so that queued frames are included.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_framestats_write(const EasyFrameStats *fs, const char *filename)
+{
+    const EasyFrameStatsTable *t = &fs->table;
+    EasyFrameStatsHeader header = { { 'E', 'F', 'S', 'T' }, EASY_FRAMESTATS_VERSION, 0, 0 };
+    size_t n = (size_t)t->nb_frames;
+    FILE *f;
+    int ok, ret = 0;
+
+    if (!(f = fopen(filename, "wb"))) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open %s\n", filename);
+        return AVERROR(errno);
+    }
+    header.nb_frames      = t->nb_frames;
+    header.has_histograms = !!t->hist;
+
+    /* an empty table has no columns allocated */
+    ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    if (n) {
+        ok = ok && fwrite(t->time, sizeof(*t->time), n, f) == n;
+        for (int p = 0; p < 3; p++)
+            ok = ok && fwrite(t->mean[p], sizeof(*t->mean[p]), n, f) == n;
+        for (int p = 0; p < 3; p++)
+            ok = ok && fwrite(t->variance[p], sizeof(*t->variance[p]), n, f) == n;
+        for (int p = 0; p < 3; p++)
+            ok = ok && fwrite(t->min[p], sizeof(*t->min[p]), n, f) == n;
+        for (int p = 0; p < 3; p++)
+            ok = ok && fwrite(t->max[p], sizeof(*t->max[p]), n, f) == n;
+        ok = ok && fwrite(t->clip_low, sizeof(*t->clip_low), n, f) == n &&
+             fwrite(t->clip_high, sizeof(*t->clip_high), n, f) == n &&
+             fwrite(t->sad, sizeof(*t->sad), n, f) == n &&
+             fwrite(t->black, sizeof(*t->black), n, f) == n &&
+             fwrite(t->frozen, sizeof(*t->frozen), n, f) == n;
+        if (t->hist)
+            ok = ok && fwrite(t->hist, 3 * EASY_FRAMESTATS_BINS * sizeof(*t->hist), n, f) == n;
+    }
+    if (!ok)
+        ret = AVERROR(EIO);
+    if (fclose(f) && ret >= 0)
+        ret = AVERROR(EIO);
+    if (ret < 0)
+        av_log(NULL, AV_LOG_ERROR, "Cannot write %s\n", filename);
+    return ret;
+}
+
+#endif // __EASY_FRAMESTATS_H__
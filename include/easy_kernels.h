@@ -0,0 +1,98 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_KERNELS_H__
+#define __EASY_KERNELS_H__
+
+/*
+ * Hot pixel kernels of the compiled libeasyffmpeg.
+ *
+ * Every kernel is built for several instruction sets (baseline, AVX2,
+ * AVX-512) and the best one the CPU supports is picked when the library is
+ * loaded, so one binary runs at full speed across a mixed fleet. Set
+ * EASY_KERNELS=c, avx2 or avx512 in the environment to force a lower level.
+ *
+ * Targets linking the library get EASY_HAVE_KERNELS defined, which routes
+ * the matching header-only helpers (easy_color.h, easy_scene.h) here.
+ */
+
+#include "easy_common.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EASY_KERNEL_YUV_BITS 16
+
+/**
+ * Fixed-point coefficients of an 8-bit YUV->RGB matrix, scaled by
+ * 1 << EASY_KERNEL_YUV_BITS.
+ *
+ * R = (Y * y_mul + y_add + (V - 128) * v_r) >> EASY_KERNEL_YUV_BITS, and
+ * likewise for G and B. y_add folds in the luma offset and the rounding bias.
+ */
+typedef struct EasyKernelYuvCoeffs {
+    int32_t y_mul, y_add;
+    int32_t v_r, u_g, v_g, u_b;
+} EasyKernelYuvCoeffs;
+
+/**
+ * Convert 8-bit planar YUV to packed RGB24.
+ *
+ * @param c The matrix coefficients.
+ * @param data The Y, U and V plane pointers.
+ * @param linesize The Y, U and V linesizes in bytes.
+ * @param width The width of the image in pixels.
+ * @param height The height of the image in pixels.
+ * @param log2_chroma_w The horizontal chroma subsampling shift.
+ * @param log2_chroma_h The vertical chroma subsampling shift.
+ * @param rgb The destination buffer.
+ * @param rgb_linesize The number of bytes in a row of the destination.
+ *
+ * @return 0 on success, -1 if the row scratch could not be allocated.
+ */
+EASY_API int easy_kernel_yuv_to_rgb24(const EasyKernelYuvCoeffs *c, const uint8_t *const data[3],
+                                      const int linesize[3], int width, int height,
+                                      int log2_chroma_w, int log2_chroma_h,
+                                      uint8_t *rgb, int rgb_linesize);
+
+/**
+ * Copy the rows of a plane.
+ *
+ * @param bytewidth The number of bytes to copy per row.
+ */
+EASY_API void easy_kernel_copy_plane(uint8_t *dst, ptrdiff_t dst_linesize,
+                                     const uint8_t *src, ptrdiff_t src_linesize,
+                                     int bytewidth, int height);
+
+/**
+ * Sum of absolute differences of two 8-bit planes.
+ */
+EASY_API uint64_t easy_kernel_sad_plane(const uint8_t *a, ptrdiff_t a_linesize,
+                                        const uint8_t *b, ptrdiff_t b_linesize,
+                                        int width, int height);
+
+/**
+ * Get the instruction set the kernels were dispatched to: "c", "avx2" or "avx512".
+ */
+EASY_API const char *easy_kernels_isa(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __EASY_KERNELS_H__
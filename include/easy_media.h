@@ -16,34 +16,156 @@
 #define __EASY_MEDIA_H__
 
 #include "easy_common.h"
+#include "easy_decoder_pool.h"
+#include "easy_frame_pool.h"
+#include "easy_trace.h"
 
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
+#include <libavutil/dict.h>
+#include <libavutil/time.h>
+
+#include <string.h>
+
+/*
+ * Bytes probed before the first packet of a live input. MPEG-TS needs a few
+ * packets of 188 bytes to be detected on a pipe and its PAT/PMT to create the
+ * streams, far more than the 32 byte minimum. Define it to trade first-frame
+ * latency against detection of sparse program tables.
+ */
+#ifndef EASY_LIVE_PROBESIZE
+#define EASY_LIVE_PROBESIZE 8192
+#endif
+
+/* EasyVideoOptions.threads value letting libavcodec start one thread per core */
+#define EASY_VIDEO_THREADS_AUTO -1
 
 /**
- * Open an input file and prepare it for decoding.
+ * Options controlling how easy_open_video2() sets up the decoder.
+ * Zero-initialize it and set only the fields you need.
+ */
+typedef struct EasyVideoOptions {
+    EasyFramePool *frame_pool; ///< pool to allocate decoded frames from, NULL for FFmpeg's default allocator
+    int            luma_only;  ///< ask the decoder to skip chroma (AV_CODEC_FLAG_GRAY), only data[0] is meaningful
+    int            live;       ///< low-latency input from a pipe, FIFO or stdin ("-"), see easy_open_input()
+    EasyDecoderPool *decoder_pool; ///< reuse opened decoders, give them back with easy_decoder_pool_release()
+    int            threads;    ///< decoder threads, 0 keeps libavcodec's default of one, or EASY_VIDEO_THREADS_AUTO
+} EasyVideoOptions;
+
+/**
+ * Open an input and read its stream information.
+ *
+ * In live mode "-" reads stdin, probing is cut to EASY_LIVE_PROBESIZE bytes, the demuxer
+ * does not delay or buffer packets (AVFMT_FLAG_NOBUFFER) and stream
+ * information is only probed when the container header lacks it. Named
+ * FIFOs and pipe: URLs are opened like files.
+ *
+ * @param fmt_ctx A pointer to a pointer to an AVFormatContext, which will be allocated and initialized.
+ *                A context preallocated with avformat_alloc_context(), e.g. to
+ *                set an interrupt_callback, is used as is and freed on failure.
+ * @param filename The name of the input.
+ * @param live Non-zero for a live input.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_open_input(AVFormatContext **fmt_ctx, const char *filename, int live)
+{
+    AVDictionary *format_opts = NULL;
+    int probe = 1, ret;
+
+    if (live) {
+        if (!strcmp(filename, "-"))
+            filename = "pipe:0";
+        av_dict_set_int(&format_opts, "probesize", EASY_LIVE_PROBESIZE, 0);
+        av_dict_set(&format_opts, "analyzeduration", "0", 0);
+        av_dict_set(&format_opts, "fpsprobesize", "0", 0);
+        /* no demuxer side reordering delay (mpegts, ps) */
+        av_dict_set(&format_opts, "max_delay", "0", 0);
+    }
+
+    EASY_TRACE_CALL("open_input", ret = avformat_open_input(fmt_ctx, filename, NULL, &format_opts));
+    av_dict_free(&format_opts);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
+        return ret;
+    }
+
+    if (live) {
+        /* every stream known from the header already, skip reading ahead */
+        probe = !(*fmt_ctx)->nb_streams;
+        for (unsigned i = 0; i < (*fmt_ctx)->nb_streams; i++)
+            if ((*fmt_ctx)->streams[i]->codecpar->codec_id == AV_CODEC_ID_NONE)
+                probe = 1;
+    }
+    if (probe) {
+        EASY_TRACE_CALL("find_stream_info", ret = avformat_find_stream_info(*fmt_ctx, NULL));
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Cannot find stream information\n");
+            return ret;
+        }
+    }
+
+    /* set after probing, with it find_stream_info would drop the packets it
+     * read, losing the first keyframe */
+    if (live)
+        (*fmt_ctx)->flags |= AVFMT_FLAG_NOBUFFER;
+
+    return 0;
+}
+
+/**
+ * Configure a decoder to output every frame as early as the codec allows:
+ * no frame threading (which delays output by one frame per thread) and
+ * AV_CODEC_FLAG_LOW_DELAY. Call it before avcodec_open2().
+ */
+static inline void easy_codec_set_low_delay(AVCodecContext *avctx)
+{
+    avctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    avctx->thread_type = FF_THREAD_SLICE;
+}
+
+/**
+ * Get how long ago a frame was captured, for inputs that map their
+ * timestamps to wall-clock time (fmt_ctx->start_time_realtime, e.g. RTSP with
+ * RTCP sender reports).
+ *
+ * @return The glass-to-frame latency in microseconds, AV_NOPTS_VALUE if the
+ *         input has no wall-clock reference.
+ */
+static inline int64_t easy_frame_capture_latency(const AVFormatContext *fmt_ctx, int stream_index,
+                                                 const AVFrame *frame)
+{
+    const AVStream *st = fmt_ctx->streams[stream_index];
+    int64_t pts = frame->best_effort_timestamp;
+
+    if (fmt_ctx->start_time_realtime == AV_NOPTS_VALUE || !fmt_ctx->start_time_realtime ||
+        pts == AV_NOPTS_VALUE)
+        return AV_NOPTS_VALUE;
+    if (st->start_time != AV_NOPTS_VALUE)
+        pts -= st->start_time;
+    return av_gettime() - (fmt_ctx->start_time_realtime + av_rescale_q(pts, st->time_base, AV_TIME_BASE_Q));
+}
+
+/**
+ * Open an input file and prepare it for decoding with the given options.
  * 
  * @param filename The name of the input file.
  * @param fmt_ctx A pointer to a pointer to an AVFormatContext, which will be allocated and initialized.
  * @param dec_ctx A pointer to a pointer to an AVCodecContext, which will be allocated and initialized.
  * @param video_stream_index A pointer to an integer that will store the index of the video stream.
+ * @param opts The decoding options, may be NULL.
  * 
  * @return 0 on success, a negative AVERROR code on failure.
  */
-static inline int easy_open_video(const char *filename, AVFormatContext **fmt_ctx, AVCodecContext **dec_ctx, int *video_stream_index)
+static inline int easy_open_video2(const char *filename, AVFormatContext **fmt_ctx, AVCodecContext **dec_ctx,
+                                   int *video_stream_index, const EasyVideoOptions *opts)
 {
+    int64_t start = av_gettime_relative();
     const AVCodec *dec;
     int ret;
 
-    if ((ret = avformat_open_input(fmt_ctx, filename, NULL, NULL)) < 0) {
-        av_log(NULL, AV_LOG_ERROR, "Cannot open input file\n");
-        return ret;
-    }
-
-    if ((ret = avformat_find_stream_info(*fmt_ctx, NULL)) < 0) {
-        av_log(NULL, AV_LOG_ERROR, "Cannot find stream information\n");
+    if ((ret = easy_open_input(fmt_ctx, filename, opts && opts->live)) < 0)
         return ret;
-    }
 
     /* select the video stream */
     ret = av_find_best_stream(*fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &dec, 0);
@@ -59,8 +181,25 @@ static inline int easy_open_video(const char *filename, AVFormatContext **fmt_ct
         return AVERROR(ENOMEM);
     avcodec_parameters_to_context(*dec_ctx, (*fmt_ctx)->streams[*video_stream_index]->codecpar);
 
-    /* init the video decoder */
-    if ((ret = avcodec_open2(*dec_ctx, dec, NULL)) < 0) {
+    if (opts && opts->frame_pool)
+        easy_frame_pool_install(*dec_ctx, opts->frame_pool);
+    /* decoders built with gray support skip chroma reconstruction entirely,
+     * the others ignore the flag and the chroma planes are simply not read */
+    if (opts && opts->luma_only)
+        (*dec_ctx)->flags |= AV_CODEC_FLAG_GRAY;
+    if (opts && opts->threads)
+        (*dec_ctx)->thread_count = opts->threads == EASY_VIDEO_THREADS_AUTO ? 0 : opts->threads;
+    if (opts && opts->live)
+        easy_codec_set_low_delay(*dec_ctx);
+
+    (*dec_ctx)->pkt_timebase = (*fmt_ctx)->streams[*video_stream_index]->time_base;
+
+    /* init the video decoder, the pool times hits and misses from the same start */
+    if (opts && opts->decoder_pool)
+        ret = easy_decoder_pool_open2(opts->decoder_pool, dec_ctx, dec, start);
+    else
+        EASY_TRACE_CALL("open_decoder", ret = avcodec_open2(*dec_ctx, dec, NULL));
+    if (ret < 0) {
         av_log(NULL, AV_LOG_ERROR, "Cannot open video decoder\n");
         return ret;
     }
@@ -68,6 +207,21 @@ static inline int easy_open_video(const char *filename, AVFormatContext **fmt_ct
     return 0;
 }
 
+/**
+ * Open an input file and prepare it for decoding.
+ * 
+ * @param filename The name of the input file.
+ * @param fmt_ctx A pointer to a pointer to an AVFormatContext, which will be allocated and initialized.
+ * @param dec_ctx A pointer to a pointer to an AVCodecContext, which will be allocated and initialized.
+ * @param video_stream_index A pointer to an integer that will store the index of the video stream.
+ * 
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_open_video(const char *filename, AVFormatContext **fmt_ctx, AVCodecContext **dec_ctx, int *video_stream_index)
+{
+    return easy_open_video2(filename, fmt_ctx, dec_ctx, video_stream_index, NULL);
+}
+
 /**
  * Open an input file and prepare it for decoding audio.
  * 
@@ -132,7 +286,7 @@ static inline int easy_open_av(const char *filename, AVFormatContext **fmt_ctx,
                                AVCodecContext **dec_video_ctx, int *video_stream_index,
                                AVCodecContext **dec_audio_ctx, int *audio_stream_index)
 {
-    const AVCodec *dec;
+    const AVCodec *video_dec, *audio_dec;
     int ret;
 
     if ((ret = avformat_open_input(fmt_ctx, filename, NULL, NULL)) < 0) {
@@ -146,7 +300,7 @@ static inline int easy_open_av(const char *filename, AVFormatContext **fmt_ctx,
     }
 
     /* select the video stream */
-    ret = av_find_best_stream(*fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &dec, 0);
+    ret = av_find_best_stream(*fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &video_dec, 0);
     if (ret < 0) {
         av_log(NULL, AV_LOG_ERROR, "Cannot find a video stream in the input file\n");
         return ret;
@@ -154,7 +308,7 @@ static inline int easy_open_av(const char *filename, AVFormatContext **fmt_ctx,
     *video_stream_index = ret;
 
     /* select the audio stream */
-    ret = av_find_best_stream(*fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, &dec, 0);
+    ret = av_find_best_stream(*fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, *video_stream_index, &audio_dec, 0);
     if (ret < 0) {
         av_log(NULL, AV_LOG_ERROR, "Cannot find a audio stream in the input file\n");
         return ret;
@@ -162,25 +316,25 @@ static inline int easy_open_av(const char *filename, AVFormatContext **fmt_ctx,
     *audio_stream_index = ret;
 
     /* create video decoding context */
-    *dec_video_ctx = avcodec_alloc_context3(dec);
+    *dec_video_ctx = avcodec_alloc_context3(video_dec);
     if (!*dec_video_ctx)
         return AVERROR(ENOMEM);
     avcodec_parameters_to_context(*dec_video_ctx, (*fmt_ctx)->streams[*video_stream_index]->codecpar);
 
     /* create audio decoding context */
-    *dec_audio_ctx = avcodec_alloc_context3(dec);
+    *dec_audio_ctx = avcodec_alloc_context3(audio_dec);
     if (!*dec_audio_ctx)
         return AVERROR(ENOMEM);
     avcodec_parameters_to_context(*dec_audio_ctx, (*fmt_ctx)->streams[*audio_stream_index]->codecpar);
 
     /* init the video decoder */
-    if ((ret = avcodec_open2(*dec_video_ctx, dec, NULL)) < 0) {
+    if ((ret = avcodec_open2(*dec_video_ctx, video_dec, NULL)) < 0) {
         av_log(NULL, AV_LOG_ERROR, "Cannot open video decoder\n");
         return ret;
     }
 
     /* init the audio decoder */
-    if ((ret = avcodec_open2(*dec_audio_ctx, dec, NULL)) < 0) {
+    if ((ret = avcodec_open2(*dec_audio_ctx, audio_dec, NULL)) < 0) {
         av_log(NULL, AV_LOG_ERROR, "Cannot open audio decoder\n");
         return ret;
     }
@@ -188,6 +342,88 @@ static inline int easy_open_av(const char *filename, AVFormatContext **fmt_ctx,
     return 0;
 }
 
+/**
+ * Callback receiving the luma plane of every decoded frame.
+ * 
+ * @param y The pointer to the Y plane data.
+ * @param y_linesize The number of bytes in a row of the Y plane.
+ * @param width The width of the image in pixels.
+ * @param height The height of the image in pixels.
+ * @param pts The presentation timestamp of the frame in stream time base.
+ * @param opaque The pointer passed to easy_decode_luma().
+ * 
+ * @return 0 to continue decoding, a negative value to stop.
+ */
+typedef int (*EasyLumaCallback)(const unsigned char *y, int y_linesize, int width, int height,
+                                int64_t pts, void *opaque);
+
+/* Drain every frame the decoder has ready and hand its luma plane over. */
+static inline int easy_decode_luma_frames(AVCodecContext *dec_ctx, AVFrame *frame,
+                                          EasyLumaCallback callback, void *opaque)
+{
+    int ret;
+
+    while ((ret = avcodec_receive_frame(dec_ctx, frame)) >= 0) {
+        ret = callback(frame->data[0], frame->linesize[0], frame->width, frame->height,
+                       frame->best_effort_timestamp, opaque);
+        av_frame_unref(frame);
+        if (ret < 0)
+            return ret;
+    }
+    return ret == AVERROR(EAGAIN) ? 0 : ret;
+}
+
+/**
+ * Decode a video stream and stream its luma planes to a callback.
+ * 
+ * The plane is only valid during the callback, this keeps a single frame in
+ * flight. Open the decoder with EasyVideoOptions.luma_only to let it skip
+ * chroma work, e.g. for motion detection or OCR pre-processing.
+ * 
+ * @param fmt_ctx The demuxer opened by easy_open_video2().
+ * @param dec_ctx The decoder opened by easy_open_video2().
+ * @param video_stream_index The index of the video stream.
+ * @param callback The consumer, called once per decoded frame.
+ * @param opaque A pointer passed through to the callback.
+ * 
+ * @return 0 once the whole stream was consumed, the callback's return value
+ *         if it stopped decoding, a negative AVERROR code on failure.
+ */
+static inline int easy_decode_luma(AVFormatContext *fmt_ctx, AVCodecContext *dec_ctx, int video_stream_index,
+                                   EasyLumaCallback callback, void *opaque)
+{
+    AVPacket *pkt = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    int ret = 0;
+
+    if (!pkt || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    while (av_read_frame(fmt_ctx, pkt) >= 0) {
+        if (pkt->stream_index == video_stream_index) {
+            ret = avcodec_send_packet(dec_ctx, pkt);
+            if (ret >= 0)
+                ret = easy_decode_luma_frames(dec_ctx, frame, callback, opaque);
+        }
+        av_packet_unref(pkt);
+        if (ret < 0)
+            goto end;
+    }
+
+    /* flush the decoder */
+    if ((ret = avcodec_send_packet(dec_ctx, NULL)) >= 0)
+        ret = easy_decode_luma_frames(dec_ctx, frame, callback, opaque);
+    if (ret == AVERROR_EOF)
+        ret = 0;
+
+end:
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    return ret;
+}
+
 static inline void easy_alloc_frame(AVFrame **frame, int width, int height, enum AVPixelFormat pixel_format);
 
 
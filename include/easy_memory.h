@@ -0,0 +1,412 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_MEMORY_H__
+#define __EASY_MEMORY_H__
+
+#include "easy_common.h"
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+#include <libavutil/frame.h>
+#include <libavutil/mem.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * A memory budget shared by every decoder, demuxer and conversion buffer
+ * that is registered with it.
+ *
+ * Frames and packets are charged when they are tracked and refunded
+ * automatically once the last reference to them is released, so the budget
+ * follows frames through filter graphs and queues without extra bookkeeping.
+ * Create one budget per process (or per worker) and pass the same pointer to
+ * all contexts that should share the limit.
+ */
+typedef struct EasyMemBudget {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    int64_t         limit;   ///< budget in bytes, <= 0 means unlimited
+    int64_t         used;    ///< bytes currently charged
+    int64_t         peak;    ///< highest value reached by used
+    int             aborted; ///< set by easy_mem_budget_abort()
+} EasyMemBudget;
+
+/**
+ * How a charge behaves when the budget is exhausted.
+ */
+enum EasyMemMode {
+    EASY_MEM_WAIT,   ///< block until enough memory has been released
+    EASY_MEM_NOWAIT, ///< fail with AVERROR(EAGAIN)
+    EASY_MEM_FORCE,  ///< charge anyway, the caller polls easy_mem_budget_exceeded()
+};
+
+/**
+ * A single charge against a budget, kept alive by the opaque_ref of the
+ * frame or packet it was made for.
+ */
+typedef struct EasyMemCharge {
+    EasyMemBudget *budget;
+    int64_t        bytes;
+} EasyMemCharge;
+
+/**
+ * Initialize a memory budget.
+ *
+ * @param budget The budget to initialize.
+ * @param limit The number of bytes that may be held at once, <= 0 for no limit.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_mem_budget_init(EasyMemBudget *budget, int64_t limit)
+{
+    budget->limit   = limit;
+    budget->used    = 0;
+    budget->peak    = 0;
+    budget->aborted = 0;
+
+    if (pthread_mutex_init(&budget->lock, NULL))
+        return AVERROR(ENOMEM);
+    if (pthread_cond_init(&budget->cond, NULL)) {
+        pthread_mutex_destroy(&budget->lock);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+/**
+ * Release the resources of a memory budget.
+ *
+ * @note Every tracked frame and packet must have been freed before this call.
+ */
+static inline void easy_mem_budget_uninit(EasyMemBudget *budget)
+{
+    if (budget->used)
+        av_log(NULL, AV_LOG_WARNING, "Memory budget destroyed with %lld bytes still charged\n",
+               (long long)budget->used);
+    pthread_cond_destroy(&budget->cond);
+    pthread_mutex_destroy(&budget->lock);
+}
+
+/**
+ * Wake up every thread blocked on the budget and make further blocking
+ * acquisitions fail with AVERROR_EXIT. Used to tear down pipelines.
+ */
+static inline void easy_mem_budget_abort(EasyMemBudget *budget)
+{
+    pthread_mutex_lock(&budget->lock);
+    budget->aborted = 1;
+    pthread_cond_broadcast(&budget->cond);
+    pthread_mutex_unlock(&budget->lock);
+}
+
+/* Must be called with the budget lock held. */
+static inline int easy_mem_budget_fits(EasyMemBudget *budget, int64_t bytes)
+{
+    /* a single oversized request is admitted once everything else has been
+     * released, otherwise it could never make progress */
+    return budget->limit <= 0 || budget->used == 0 || budget->used + bytes <= budget->limit;
+}
+
+/* Must be called with the budget lock held. */
+static inline void easy_mem_budget_charge(EasyMemBudget *budget, int64_t bytes)
+{
+    budget->used += bytes;
+    if (budget->used > budget->peak)
+        budget->peak = budget->used;
+}
+
+/**
+ * Charge bytes against the budget, blocking until enough memory is released
+ * or the caller's own cancel flag is set.
+ *
+ * Unlike easy_mem_budget_abort(), which stops every user of a shared budget,
+ * the flag only stops the threads waiting on it, e.g. those of one pipeline
+ * being closed.
+ *
+ * @param budget The budget to charge.
+ * @param bytes The number of bytes to charge.
+ * @param cancel A flag set by easy_mem_budget_cancel(), may be NULL.
+ *
+ * @return 0 on success, AVERROR_EXIT if the budget was aborted or the wait
+ *         cancelled.
+ */
+static inline int easy_mem_budget_acquire2(EasyMemBudget *budget, int64_t bytes, const int *cancel)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&budget->lock);
+    while (!budget->aborted && !(cancel && *cancel) && !easy_mem_budget_fits(budget, bytes))
+        pthread_cond_wait(&budget->cond, &budget->lock);
+    if (budget->aborted || (cancel && *cancel))
+        ret = AVERROR_EXIT;
+    else
+        easy_mem_budget_charge(budget, bytes);
+    pthread_mutex_unlock(&budget->lock);
+
+    return ret;
+}
+
+/**
+ * Charge bytes against the budget, blocking until enough memory is released.
+ *
+ * @note Only block from threads that do not themselves hold the memory that
+ *       has to be released, single threaded loops should charge with
+ *       EASY_MEM_FORCE, poll easy_mem_budget_exceeded() and drain their
+ *       consumers instead.
+ *
+ * @return 0 on success, AVERROR_EXIT if the budget was aborted.
+ */
+static inline int easy_mem_budget_acquire(EasyMemBudget *budget, int64_t bytes)
+{
+    return easy_mem_budget_acquire2(budget, bytes, NULL);
+}
+
+/**
+ * Set a cancel flag passed to easy_mem_budget_acquire2() and wake up the
+ * threads blocked on the budget, so those waiting on that flag give up. The
+ * budget itself stays usable by everyone else.
+ */
+static inline void easy_mem_budget_cancel(EasyMemBudget *budget, int *cancel)
+{
+    pthread_mutex_lock(&budget->lock);
+    *cancel = 1;
+    pthread_cond_broadcast(&budget->cond);
+    pthread_mutex_unlock(&budget->lock);
+}
+
+/**
+ * Charge bytes against the budget without blocking.
+ *
+ * @return 0 on success, AVERROR(EAGAIN) if the budget is exhausted.
+ */
+static inline int easy_mem_budget_try_acquire(EasyMemBudget *budget, int64_t bytes)
+{
+    int ret = AVERROR(EAGAIN);
+
+    pthread_mutex_lock(&budget->lock);
+    if (easy_mem_budget_fits(budget, bytes)) {
+        easy_mem_budget_charge(budget, bytes);
+        ret = 0;
+    }
+    pthread_mutex_unlock(&budget->lock);
+
+    return ret;
+}
+
+/**
+ * Give bytes back to the budget and wake up blocked producers.
+ */
+static inline void easy_mem_budget_release(EasyMemBudget *budget, int64_t bytes)
+{
+    pthread_mutex_lock(&budget->lock);
+    budget->used -= bytes;
+    pthread_cond_broadcast(&budget->cond);
+    pthread_mutex_unlock(&budget->lock);
+}
+
+/**
+ * Check whether the budget is currently exhausted.
+ *
+ * @return 1 if producers should stop reading, 0 otherwise.
+ */
+static inline int easy_mem_budget_exceeded(EasyMemBudget *budget)
+{
+    int ret;
+
+    pthread_mutex_lock(&budget->lock);
+    ret = budget->limit > 0 && budget->used >= budget->limit;
+    pthread_mutex_unlock(&budget->lock);
+
+    return ret;
+}
+
+/**
+ * Get the number of bytes held by the buffers of a frame.
+ */
+static inline int64_t easy_frame_bytes(const AVFrame *frame)
+{
+    int64_t bytes = 0;
+
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; i++)
+        bytes += frame->buf[i]->size;
+    for (int i = 0; i < frame->nb_extended_buf; i++)
+        bytes += frame->extended_buf[i]->size;
+
+    return bytes;
+}
+
+/**
+ * Get the number of bytes held by a packet.
+ */
+static inline int64_t easy_packet_bytes(const AVPacket *pkt)
+{
+    return pkt->buf ? (int64_t)pkt->buf->size : pkt->size;
+}
+
+static inline void easy_mem_charge_free(void *opaque, uint8_t *data)
+{
+    EasyMemCharge *charge = (EasyMemCharge *)data;
+    (void)opaque;
+
+    easy_mem_budget_release(charge->budget, charge->bytes);
+    av_free(charge);
+}
+
+/* Charge bytes and wrap the charge into a buffer that refunds it on free. */
+static inline int easy_mem_budget_make_charge(EasyMemBudget *budget, int64_t bytes, enum EasyMemMode mode,
+                                              const int *cancel, AVBufferRef **charge_ref)
+{
+    EasyMemCharge *charge;
+    int ret = 0;
+
+    switch (mode) {
+    case EASY_MEM_WAIT:
+        ret = easy_mem_budget_acquire2(budget, bytes, cancel);
+        break;
+    case EASY_MEM_NOWAIT:
+        ret = easy_mem_budget_try_acquire(budget, bytes);
+        break;
+    case EASY_MEM_FORCE:
+        pthread_mutex_lock(&budget->lock);
+        easy_mem_budget_charge(budget, bytes);
+        pthread_mutex_unlock(&budget->lock);
+        break;
+    }
+    if (ret < 0)
+        return ret;
+
+    charge = (EasyMemCharge *)av_malloc(sizeof(*charge));
+    if (charge) {
+        charge->budget = budget;
+        charge->bytes  = bytes;
+        *charge_ref = av_buffer_create((uint8_t *)charge, sizeof(*charge), easy_mem_charge_free, NULL, 0);
+    }
+    if (!charge || !*charge_ref) {
+        av_free(charge);
+        easy_mem_budget_release(budget, bytes);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+/**
+ * Charge a decoded frame against the budget, an EASY_MEM_WAIT charge gives up
+ * with AVERROR_EXIT once *cancel is set, see easy_mem_budget_acquire2().
+ */
+static inline int easy_mem_budget_track_frame2(EasyMemBudget *budget, AVFrame *frame, enum EasyMemMode mode,
+                                               const int *cancel)
+{
+    if (frame->opaque_ref) {
+        av_log(NULL, AV_LOG_ERROR, "Frame opaque_ref is already in use\n");
+        return AVERROR(EINVAL);
+    }
+    return easy_mem_budget_make_charge(budget, easy_frame_bytes(frame), mode, cancel, &frame->opaque_ref);
+}
+
+/**
+ * Charge a decoded frame against the budget.
+ *
+ * The charge is attached to frame->opaque_ref, so it is shared by every
+ * reference to the frame (av_frame_ref(), filter graphs, queues) and refunded
+ * when the last of them is released.
+ *
+ * @param budget The budget to charge.
+ * @param frame The frame to track, its opaque_ref must be unused.
+ * @param mode What to do when the budget is exhausted.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_mem_budget_track_frame(EasyMemBudget *budget, AVFrame *frame, enum EasyMemMode mode)
+{
+    return easy_mem_budget_track_frame2(budget, frame, mode, NULL);
+}
+
+#if LIBAVCODEC_VERSION_MAJOR >= 59
+/**
+ * Charge a demuxed packet against the budget, see easy_mem_budget_track_frame().
+ */
+static inline int easy_mem_budget_track_packet(EasyMemBudget *budget, AVPacket *pkt, enum EasyMemMode mode)
+{
+    if (pkt->opaque_ref) {
+        av_log(NULL, AV_LOG_ERROR, "Packet opaque_ref is already in use\n");
+        return AVERROR(EINVAL);
+    }
+    return easy_mem_budget_make_charge(budget, easy_packet_bytes(pkt), mode, NULL, &pkt->opaque_ref);
+}
+#endif
+
+/**
+ * Receive a frame from a decoder and charge it against the budget.
+ *
+ * This is a drop-in replacement for avcodec_receive_frame() for producer
+ * threads, it blocks while the budget is exhausted.
+ *
+ * @return 0 on success, otherwise the same codes as avcodec_receive_frame()
+ *         or AVERROR_EXIT if the budget was aborted.
+ */
+static inline int easy_receive_frame_budgeted(AVCodecContext *dec_ctx, AVFrame *frame, EasyMemBudget *budget)
+{
+    int ret = avcodec_receive_frame(dec_ctx, frame);
+
+    if (ret < 0 || !budget)
+        return ret;
+    if ((ret = easy_mem_budget_track_frame(budget, frame, EASY_MEM_WAIT)) < 0)
+        av_frame_unref(frame);
+    return ret;
+}
+
+/* Conversion buffers keep their size in a header so they can be refunded. */
+#define EASY_MEM_HEADER_SIZE 64
+
+/**
+ * Allocate a conversion buffer (e.g. for easy_reformat_to_rgb24()) charged
+ * against the budget. Blocks while the budget is exhausted.
+ *
+ * @return The buffer, or NULL on failure. Free it with easy_mem_budget_freep().
+ */
+static inline void *easy_mem_budget_malloc(EasyMemBudget *budget, size_t size)
+{
+    uint8_t *ptr;
+
+    if (easy_mem_budget_acquire(budget, (int64_t)size) < 0)
+        return NULL;
+    ptr = (uint8_t *)av_malloc(size + EASY_MEM_HEADER_SIZE);
+    if (!ptr) {
+        easy_mem_budget_release(budget, (int64_t)size);
+        return NULL;
+    }
+    *(size_t *)ptr = size;
+    return ptr + EASY_MEM_HEADER_SIZE;
+}
+
+/**
+ * Free a buffer returned by easy_mem_budget_malloc() and set the pointer to NULL.
+ */
+static inline void easy_mem_budget_freep(EasyMemBudget *budget, void *arg)
+{
+    uint8_t *ptr;
+
+    memcpy(&ptr, arg, sizeof(ptr));
+    if (ptr) {
+        ptr -= EASY_MEM_HEADER_SIZE;
+        easy_mem_budget_release(budget, (int64_t)*(size_t *)ptr);
+        av_free(ptr);
+    }
+    memset(arg, 0, sizeof(ptr));
+}
+
+#endif // __EASY_MEMORY_H__
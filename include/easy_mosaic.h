@@ -0,0 +1,384 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_MOSAIC_H__
+#define __EASY_MOSAIC_H__
+
+#include "easy_common.h"
+#include "easy_kernels.h"
+#include "easy_media.h"
+#include "easy_sampler.h"
+#include "easy_thread.h"
+#include "easy_trace.h"
+
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/mem.h>
+#include <libswscale/swscale.h>
+
+#include <string.h>
+
+/**
+ * A grid of tiles in one YUV420P frame. Tiles are scaled straight into their
+ * place in the frame, nothing is composed afterwards.
+ */
+typedef struct EasyMosaic {
+    AVFrame *frame;    ///< the whole sheet, black where no tile was put
+    int      cols;
+    int      rows;
+    int      tile_w;
+    int      tile_h;
+    int      spacing;  ///< pixels between tiles and around the sheet
+} EasyMosaic;
+
+/**
+ * Where the picture of one tile comes from.
+ */
+typedef struct EasyMosaicTile {
+    const char *filename;
+    double      timestamp; ///< seconds from the start of the video, 0 for the first frame
+} EasyMosaicTile;
+
+/**
+ * Allocate the sheet of a mosaic.
+ *
+ * @param mosaic The mosaic to initialize.
+ * @param cols The number of tiles per row.
+ * @param rows The number of tile rows.
+ * @param tile_w The width of a tile, rounded up to even.
+ * @param tile_h The height of a tile, rounded up to even.
+ * @param spacing The pixels between tiles, rounded up to even.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_mosaic_init(EasyMosaic *mosaic, int cols, int rows, int tile_w, int tile_h, int spacing)
+{
+    AVFrame *frame;
+    int ret;
+
+    memset(mosaic, 0, sizeof(*mosaic));
+    if (cols <= 0 || rows <= 0 || tile_w <= 0 || tile_h <= 0 || spacing < 0)
+        return AVERROR(EINVAL);
+
+    /* even sizes keep every tile on a chroma sample of the 4:2:0 sheet */
+    mosaic->cols    = cols;
+    mosaic->rows    = rows;
+    mosaic->tile_w  = FFALIGN(tile_w, 2);
+    mosaic->tile_h  = FFALIGN(tile_h, 2);
+    mosaic->spacing = FFALIGN(spacing, 2);
+
+    if (!(frame = av_frame_alloc()))
+        return AVERROR(ENOMEM);
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width  = cols * mosaic->tile_w + (cols + 1) * mosaic->spacing;
+    frame->height = rows * mosaic->tile_h + (rows + 1) * mosaic->spacing;
+    if ((ret = av_frame_get_buffer(frame, 0)) < 0) {
+        av_frame_free(&frame);
+        return ret;
+    }
+
+    memset(frame->data[0], 16, frame->linesize[0] * frame->height);
+    memset(frame->data[1], 128, frame->linesize[1] * (frame->height / 2));
+    memset(frame->data[2], 128, frame->linesize[2] * (frame->height / 2));
+    mosaic->frame = frame;
+    return 0;
+}
+
+/**
+ * Free the sheet of a mosaic.
+ */
+static inline void easy_mosaic_uninit(EasyMosaic *mosaic)
+{
+    av_frame_free(&mosaic->frame);
+}
+
+static inline void easy_mosaic_copy_plane(uint8_t *dst, int dst_linesize, const uint8_t *src, int src_linesize,
+                                          int bytewidth, int height)
+{
+#ifdef EASY_HAVE_KERNELS
+    easy_kernel_copy_plane(dst, dst_linesize, src, src_linesize, bytewidth, height);
+#else
+    av_image_copy_plane(dst, dst_linesize, src, src_linesize, bytewidth, height);
+#endif
+}
+
+/**
+ * Paint one tile black, e.g. before putting a smaller picture than the
+ * last one into it.
+ */
+static inline void easy_mosaic_clear_tile(EasyMosaic *mosaic, int index)
+{
+    AVFrame *sheet = mosaic->frame;
+    int x = mosaic->spacing + (index % mosaic->cols) * (mosaic->tile_w + mosaic->spacing);
+    int y = mosaic->spacing + (index / mosaic->cols) * (mosaic->tile_h + mosaic->spacing);
+
+    for (int j = 0; j < mosaic->tile_h; j++)
+        memset(sheet->data[0] + (y + j) * sheet->linesize[0] + x, 16, mosaic->tile_w);
+    for (int j = 0; j < mosaic->tile_h / 2; j++) {
+        memset(sheet->data[1] + (y / 2 + j) * sheet->linesize[1] + x / 2, 128, mosaic->tile_w / 2);
+        memset(sheet->data[2] + (y / 2 + j) * sheet->linesize[2] + x / 2, 128, mosaic->tile_w / 2);
+    }
+}
+
+/**
+ * Scale a frame into one tile, keeping its display aspect ratio.
+ *
+ * Tiles do not overlap, so different tiles can be put from different
+ * threads at the same time, each with its own scaler.
+ *
+ * @param mosaic The mosaic.
+ * @param index The tile, row by row from the top left.
+ * @param src The picture, any pixel format.
+ * @param sws The scaler of the calling thread, *sws is NULL at first and
+ *            must be freed with sws_freeContext() by the caller.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_mosaic_put(EasyMosaic *mosaic, int index, const AVFrame *src, struct SwsContext **sws)
+{
+    AVFrame *sheet = mosaic->frame;
+    uint8_t *dst[4] = { NULL };
+    int64_t dar_num = src->width, dar_den = src->height;
+    int full_range = src->color_range == AVCOL_RANGE_JPEG || src->format == AV_PIX_FMT_YUVJ420P ||
+                     src->format == AV_PIX_FMT_YUVJ422P || src->format == AV_PIX_FMT_YUVJ444P;
+    int *inv_table, *table, src_range, dst_range, brightness, contrast, saturation;
+    int x, y, w, h;
+
+    if (index < 0 || index >= mosaic->cols * mosaic->rows)
+        return AVERROR(EINVAL);
+
+    if (src->sample_aspect_ratio.num > 0 && src->sample_aspect_ratio.den > 0) {
+        dar_num *= src->sample_aspect_ratio.num;
+        dar_den *= src->sample_aspect_ratio.den;
+    }
+    /* fit in the tile, the leftover becomes black bars on both sides */
+    w = mosaic->tile_w;
+    h = (int)(w * dar_den / dar_num) & ~1;
+    if (h > mosaic->tile_h || h <= 0) {
+        h = mosaic->tile_h;
+        w = (int)(h * dar_num / dar_den) & ~1;
+    }
+    w = av_clip(w, 2, mosaic->tile_w);
+    h = av_clip(h, 2, mosaic->tile_h);
+
+    x = mosaic->spacing + (index % mosaic->cols) * (mosaic->tile_w + mosaic->spacing) + ((mosaic->tile_w - w) / 2 & ~1);
+    y = mosaic->spacing + (index / mosaic->cols) * (mosaic->tile_h + mosaic->spacing) + ((mosaic->tile_h - h) / 2 & ~1);
+
+    dst[0] = sheet->data[0] + y * sheet->linesize[0] + x;
+    dst[1] = sheet->data[1] + y / 2 * sheet->linesize[1] + x / 2;
+    dst[2] = sheet->data[2] + y / 2 * sheet->linesize[2] + x / 2;
+
+    /* already the tile size and limited range like the sheet, e.g. inputs of a
+     * compositor sized for their cell. Full range input goes through swscale,
+     * which maps it to the limited range of the sheet. */
+    if (src->format == AV_PIX_FMT_YUV420P && !full_range && src->width == w && src->height == h) {
+        int64_t trace = easy_trace_begin();
+        easy_mosaic_copy_plane(dst[0], sheet->linesize[0], src->data[0], src->linesize[0], w, h);
+        easy_mosaic_copy_plane(dst[1], sheet->linesize[1], src->data[1], src->linesize[1], w / 2, h / 2);
+        easy_mosaic_copy_plane(dst[2], sheet->linesize[2], src->data[2], src->linesize[2], w / 2, h / 2);
+        easy_trace_end(trace, "copy_plane");
+        return 0;
+    }
+
+    *sws = sws_getCachedContext(*sws, src->width, src->height, (enum AVPixelFormat)src->format,
+                                w, h, AV_PIX_FMT_YUV420P, SWS_BILINEAR, NULL, NULL, NULL);
+    if (!*sws) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot create the scaler of tile %d\n", index);
+        return AVERROR(EINVAL);
+    }
+    /* swscale knows YUVJ formats are full range, not frames only tagged so */
+    if (sws_getColorspaceDetails(*sws, &inv_table, &src_range, &table, &dst_range, &brightness, &contrast,
+                                 &saturation) >= 0 && src_range != full_range)
+        sws_setColorspaceDetails(*sws, inv_table, full_range, table, dst_range, brightness, contrast, saturation);
+    EASY_TRACE_CALL("sws_scale",
+                    sws_scale(*sws, (const uint8_t *const *)src->data, src->linesize, 0, src->height,
+                              dst, sheet->linesize));
+    return 0;
+}
+
+/*
+ * A run of tiles from the same file, decoded by one worker with its own
+ * demuxer and decoder.
+ */
+typedef struct EasyMosaicJob {
+    int first;
+    int count;
+} EasyMosaicJob;
+
+typedef struct EasyMosaicBuild {
+    EasyMosaic           *mosaic;
+    const EasyMosaicTile *tiles;
+    EasyMosaicJob        *jobs;
+    struct SwsContext   **sws;      ///< one per worker
+} EasyMosaicBuild;
+
+typedef struct EasyMosaicSample {
+    EasyMosaicBuild *build;
+    int              first;
+    int              worker;
+} EasyMosaicSample;
+
+static inline int easy_mosaic_sample_cb(const AVFrame *frame, int index, double timestamp, void *opaque)
+{
+    EasyMosaicSample *s = (EasyMosaicSample *)opaque;
+    (void)timestamp;
+    return easy_mosaic_put(s->build->mosaic, s->first + index, frame, &s->build->sws[s->worker]);
+}
+
+static inline int easy_mosaic_job(void *opaque, int job, int worker)
+{
+    EasyMosaicBuild *build = (EasyMosaicBuild *)opaque;
+    const EasyMosaicJob *j = &build->jobs[job];
+    EasyMosaicSample sample = { build, j->first, worker };
+    AVFormatContext *fmt_ctx = NULL;
+    AVCodecContext *dec_ctx = NULL;
+    double *timestamps;
+    int stream_index, ret;
+
+    timestamps = (double *)av_malloc_array(j->count, sizeof(*timestamps));
+    if (!timestamps)
+        return AVERROR(ENOMEM);
+    for (int i = 0; i < j->count; i++)
+        timestamps[i] = build->tiles[j->first + i].timestamp;
+
+    /* the workers already keep every core busy, so each decoder runs single threaded */
+    ret = easy_open_video(build->tiles[j->first].filename, &fmt_ctx, &dec_ctx, &stream_index);
+    if (ret >= 0)
+        ret = easy_sample_frames(fmt_ctx, dec_ctx, stream_index, timestamps, j->count,
+                                 easy_mosaic_sample_cb, &sample, NULL);
+    if (ret < 0)
+        av_log(NULL, AV_LOG_ERROR, "Cannot fill the tiles of %s\n", build->tiles[j->first].filename);
+
+    avcodec_free_context(&dec_ctx);
+    avformat_close_input(&fmt_ctx);
+    av_free(timestamps);
+    return ret;
+}
+
+/**
+ * Decode and place the picture of every tile, in parallel.
+ *
+ * Consecutive tiles of the same file are split into runs of about
+ * nb_tiles / (2 * nb_threads) tiles. Each run is decoded by one worker
+ * which seeks between its timestamps with easy_sample_frames(), so runs
+ * of one long file and tiles of many files both spread over all threads.
+ *
+ * @param mosaic The mosaic, from easy_mosaic_init().
+ * @param tiles The source of each tile, row by row, at most cols * rows.
+ * @param nb_tiles The number of tiles.
+ * @param nb_threads The number of threads, <= 0 for one per CPU.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_mosaic_build(EasyMosaic *mosaic, const EasyMosaicTile *tiles, int nb_tiles, int nb_threads)
+{
+    EasyMosaicBuild build = { mosaic, tiles, NULL, NULL };
+    EasyWorkerPool pool;
+    int nb_jobs = 0, run, ret;
+
+    if (nb_tiles > mosaic->cols * mosaic->rows)
+        return AVERROR(EINVAL);
+    if ((ret = easy_worker_pool_init(&pool, nb_threads)) < 0)
+        return ret;
+
+    build.jobs = (EasyMosaicJob *)av_calloc(FFMAX(nb_tiles, 1), sizeof(*build.jobs));
+    build.sws  = (struct SwsContext **)av_calloc(pool.nb_threads, sizeof(*build.sws));
+    if (!build.jobs || !build.sws) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    run = FFMAX(1, nb_tiles / (2 * pool.nb_threads));
+    for (int i = 0; i < nb_tiles; i++) {
+        EasyMosaicJob *last = nb_jobs ? &build.jobs[nb_jobs - 1] : NULL;
+        if (last && last->count < run && !strcmp(tiles[last->first].filename, tiles[i].filename)) {
+            last->count++;
+        } else {
+            build.jobs[nb_jobs].first = i;
+            build.jobs[nb_jobs].count = 1;
+            nb_jobs++;
+        }
+    }
+
+    ret = easy_worker_pool_execute(&pool, easy_mosaic_job, &build, nb_jobs);
+
+end:
+    if (build.sws)
+        for (int i = 0; i < pool.nb_threads; i++)
+            sws_freeContext(build.sws[i]);
+    av_free(build.sws);
+    av_free(build.jobs);
+    easy_worker_pool_uninit(&pool);
+    return ret;
+}
+
+/**
+ * Build a contact sheet of one video: cols * rows frames evenly spread over
+ * its duration.
+ *
+ * @param mosaic The mosaic to initialize, free it with easy_mosaic_uninit().
+ * @param filename The video.
+ * @param cols The number of tiles per row.
+ * @param rows The number of tile rows.
+ * @param tile_w The width of a tile, the height follows the video's aspect ratio.
+ * @param nb_threads The number of threads, <= 0 for one per CPU.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_contact_sheet(EasyMosaic *mosaic, const char *filename, int cols, int rows, int tile_w,
+                                     int nb_threads)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    EasyMosaicTile *tiles = NULL;
+    const AVCodecParameters *par;
+    AVRational sar;
+    double duration;
+    int nb_tiles = cols * rows, tile_h, ret;
+
+    memset(mosaic, 0, sizeof(*mosaic));
+    if ((ret = easy_open_input(&fmt_ctx, filename, 0)) < 0)
+        return ret;
+    if ((ret = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0)) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find a video stream in the input file\n");
+        goto end;
+    }
+    par = fmt_ctx->streams[ret]->codecpar;
+    sar = par->sample_aspect_ratio.num > 0 ? par->sample_aspect_ratio : av_make_q(1, 1);
+    tile_h = (int)av_rescale(tile_w, (int64_t)par->height * sar.den, (int64_t)par->width * sar.num);
+    duration = fmt_ctx->duration != AV_NOPTS_VALUE ? fmt_ctx->duration / (double)AV_TIME_BASE : 0;
+
+    if (!(tiles = (EasyMosaicTile *)av_malloc_array(nb_tiles, sizeof(*tiles)))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    /* the middle of each of nb_tiles equal parts, away from fades at both ends */
+    for (int i = 0; i < nb_tiles; i++) {
+        tiles[i].filename  = filename;
+        tiles[i].timestamp = duration * (i + 0.5) / nb_tiles;
+    }
+
+    if ((ret = easy_mosaic_init(mosaic, cols, rows, tile_w, FFMAX(tile_h, 2), 4)) < 0)
+        goto end;
+    if ((ret = easy_mosaic_build(mosaic, tiles, nb_tiles, nb_threads)) < 0)
+        easy_mosaic_uninit(mosaic);
+
+end:
+    av_free(tiles);
+    avformat_close_input(&fmt_ctx);
+    return ret;
+}
+
+#endif // __EASY_MOSAIC_H__
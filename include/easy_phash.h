@@ -0,0 +1,628 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_PHASH_H__
+#define __EASY_PHASH_H__
+
+#include "easy_common.h"
+#include "easy_media.h"
+#include "easy_sampler.h"
+
+#include <libavutil/frame.h>
+#include <libavutil/mem.h>
+#include <libavutil/pixdesc.h>
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EASY_PHASH_SIZE  32  // luma is reduced to 32x32 before the DCT
+#define EASY_PHASH_BITS  8   // the 8x8 lowest frequencies, DC excluded, give the 64 bits
+
+/* 4 tables indexed by 16 bits of the hash each */
+#define EASY_PHASH_CHUNKS       4
+#define EASY_PHASH_CHUNK_VALUES (1 << 16)
+/* the largest distance a search supports, 3 differing bits per chunk */
+#define EASY_PHASH_MAX_DISTANCE 15
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define EASY_PHASH_INDEX_MAGIC   "EPHI"
+#define EASY_PHASH_INDEX_VERSION 1
+
+/**
+ * Computes 64-bit DCT perceptual hashes of frames.
+ *
+ * The luma plane is box-filtered to 32x32, transformed with a 2D DCT-II and
+ * each of the 64 lowest non-DC coefficients becomes one bit, set when it is
+ * above their median. Re-encodes, rescales and mild color or brightness
+ * changes flip only a few bits.
+ */
+typedef struct EasyPHasher {
+    float     dct[EASY_PHASH_BITS][EASY_PHASH_SIZE]; ///< cosine basis rows 1 to 8
+    uint32_t *row_sum;                              ///< per-column sums of one band of rows
+    int       row_sum_size;
+} EasyPHasher;
+
+/**
+ * Initialize a hasher.
+ */
+static inline void easy_phash_init(EasyPHasher *h)
+{
+    memset(h, 0, sizeof(*h));
+    for (int u = 0; u < EASY_PHASH_BITS; u++)
+        for (int x = 0; x < EASY_PHASH_SIZE; x++)
+            h->dct[u][x] = (float)cos(M_PI * (u + 1) * (2 * x + 1) / (2.0 * EASY_PHASH_SIZE));
+}
+
+/**
+ * Free the buffers of a hasher.
+ */
+static inline void easy_phash_uninit(EasyPHasher *h)
+{
+    av_freep(&h->row_sum);
+    h->row_sum_size = 0;
+}
+
+/**
+ * Number of differing bits of two hashes, 0-64.
+ */
+static inline int easy_phash_distance(uint64_t a, uint64_t b)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(a ^ b);
+#else
+    uint64_t x = a ^ b;
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+static inline int easy_phash_cmp_float(const void *a, const void *b)
+{
+    float fa = *(const float *)a, fb = *(const float *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+/**
+ * Hash one frame.
+ *
+ * @param h The hasher.
+ * @param frame A frame in a YUV or gray format with its 8 to 16-bit luma in a plane of its own,
+ *              at least 32x32.
+ * @param hash Set to the hash.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_phash_frame(EasyPHasher *h, const AVFrame *frame, uint64_t *hash)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+    float small[EASY_PHASH_SIZE][EASY_PHASH_SIZE], tmp[EASY_PHASH_BITS][EASY_PHASH_SIZE];
+    float coeffs[EASY_PHASH_BITS * EASY_PHASH_BITS], sorted[EASY_PHASH_BITS * EASY_PHASH_BITS];
+    int width = frame->width, height = frame->height, high;
+    float median;
+
+    if (!desc || (desc->flags & AV_PIX_FMT_FLAG_RGB) || width < EASY_PHASH_SIZE || height < EASY_PHASH_SIZE)
+        return AVERROR(EINVAL);
+    high = desc->comp[0].depth > 8;
+    /* luma must have a plane of its own, packed YUYV and friends are not handled */
+    if (desc->comp[0].plane != 0 || desc->comp[0].step != (high ? 2 : 1))
+        return AVERROR(EINVAL);
+
+    if (h->row_sum_size < width) {
+        av_freep(&h->row_sum);
+        if (!(h->row_sum = (uint32_t *)av_malloc_array(width, sizeof(*h->row_sum))))
+            return AVERROR(ENOMEM);
+        h->row_sum_size = width;
+    }
+
+    /* box filter: sum each band of rows into row_sum, then each run of columns */
+    for (int by = 0; by < EASY_PHASH_SIZE; by++) {
+        int y0 = by * height / EASY_PHASH_SIZE, y1 = (by + 1) * height / EASY_PHASH_SIZE;
+        uint32_t *sum = h->row_sum;
+
+        memset(sum, 0, width * sizeof(*sum));
+        for (int y = y0; y < y1; y++) {
+            const uint8_t *row = frame->data[0] + (ptrdiff_t)y * frame->linesize[0];
+            /* kept as plain widening adds so the compiler vectorizes them */
+            if (high) {
+                const uint16_t *src = (const uint16_t *)row;
+                for (int x = 0; x < width; x++)
+                    sum[x] += src[x] >> (desc->comp[0].depth - 8);
+            } else {
+                const uint8_t *src = row;
+                for (int x = 0; x < width; x++)
+                    sum[x] += src[x];
+            }
+        }
+        for (int bx = 0; bx < EASY_PHASH_SIZE; bx++) {
+            int x0 = bx * width / EASY_PHASH_SIZE, x1 = (bx + 1) * width / EASY_PHASH_SIZE;
+            uint64_t total = 0;
+            for (int x = x0; x < x1; x++)
+                total += sum[x];
+            small[by][bx] = (float)total / ((x1 - x0) * (y1 - y0));
+        }
+    }
+
+    /* separable DCT restricted to the 8 wanted frequencies of each axis */
+    for (int u = 0; u < EASY_PHASH_BITS; u++)
+        for (int x = 0; x < EASY_PHASH_SIZE; x++) {
+            float acc = 0;
+            for (int y = 0; y < EASY_PHASH_SIZE; y++)
+                acc += h->dct[u][y] * small[y][x];
+            tmp[u][x] = acc;
+        }
+    for (int u = 0; u < EASY_PHASH_BITS; u++)
+        for (int v = 0; v < EASY_PHASH_BITS; v++) {
+            float acc = 0;
+            for (int x = 0; x < EASY_PHASH_SIZE; x++)
+                acc += tmp[u][x] * h->dct[v][x];
+            coeffs[u * EASY_PHASH_BITS + v] = acc;
+        }
+
+    memcpy(sorted, coeffs, sizeof(coeffs));
+    qsort(sorted, FF_ARRAY_ELEMS(sorted), sizeof(*sorted), easy_phash_cmp_float);
+    median = (sorted[31] + sorted[32]) / 2;
+
+    *hash = 0;
+    for (int i = 0; i < 64; i++)
+        if (coeffs[i] > median)
+            *hash |= 1ULL << i;
+    return 0;
+}
+
+/**
+ * A near-duplicate index of hashes, searched by Hamming distance.
+ *
+ * Multi-index hashing: the 64 bits are split into 4 chunks of 16 bits and
+ * each chunk value has a bucket listing the entries carrying it, stored as
+ * one offset table and one position array per chunk. Two hashes within
+ * distance d share at least one chunk within distance d / 4, so a search
+ * only visits the buckets of the query chunks and their few close
+ * neighbors instead of every entry.
+ *
+ * The file holds the header, hashes, ids, then the 4 offset tables and
+ * position arrays, in native byte order, about 32 bytes per entry. The
+ * per-bucket hash copies used by searches are rebuilt on load.
+ */
+typedef struct EasyPHashIndex {
+    uint64_t *hashes;
+    uint64_t *ids;        ///< user value of each entry, e.g. video << 32 | frame
+    uint32_t *offsets[EASY_PHASH_CHUNKS];   ///< bucket v of chunk c is positions[c][offsets[c][v]..offsets[c][v + 1]]
+    uint32_t *positions[EASY_PHASH_CHUNKS];
+    uint64_t *bucket_hashes[EASY_PHASH_CHUNKS]; ///< hashes[positions[c][p]] in bucket order, not stored in the file
+    int64_t   nb_entries;
+    int64_t   capacity;
+    int64_t   nb_indexed; ///< entries covered by the buckets, the rest were added since
+} EasyPHashIndex;
+
+typedef struct EasyPHashIndexHeader {
+    char     magic[4];
+    uint32_t version;
+    uint64_t nb_entries;
+} EasyPHashIndexHeader;
+
+/**
+ * One search result.
+ */
+typedef struct EasyPHashMatch {
+    uint64_t id;
+    uint64_t hash;
+    int      distance;
+} EasyPHashMatch;
+
+/**
+ * Initialize an empty index.
+ */
+static inline void easy_phash_index_init(EasyPHashIndex *idx)
+{
+    memset(idx, 0, sizeof(*idx));
+}
+
+/**
+ * Free the entries and buckets of an index.
+ */
+static inline void easy_phash_index_uninit(EasyPHashIndex *idx)
+{
+    av_freep(&idx->hashes);
+    av_freep(&idx->ids);
+    for (int c = 0; c < EASY_PHASH_CHUNKS; c++) {
+        av_freep(&idx->offsets[c]);
+        av_freep(&idx->positions[c]);
+        av_freep(&idx->bucket_hashes[c]);
+    }
+    memset(idx, 0, sizeof(*idx));
+}
+
+/**
+ * Add one hash. It is searchable after the next easy_phash_index_build().
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_phash_index_add(EasyPHashIndex *idx, uint64_t hash, uint64_t id)
+{
+    if (idx->nb_entries == idx->capacity) {
+        int64_t capacity = FFMAX(1024, idx->capacity * 2);
+        uint64_t *hashes, *ids;
+
+        if (capacity > UINT32_MAX)
+            return AVERROR(ERANGE);
+        if (!(hashes = (uint64_t *)av_realloc_array(idx->hashes, capacity, sizeof(*hashes))))
+            return AVERROR(ENOMEM);
+        idx->hashes = hashes;
+        if (!(ids = (uint64_t *)av_realloc_array(idx->ids, capacity, sizeof(*ids))))
+            return AVERROR(ENOMEM);
+        idx->ids      = ids;
+        idx->capacity = capacity;
+    }
+    idx->hashes[idx->nb_entries] = hash;
+    idx->ids[idx->nb_entries]    = id;
+    idx->nb_entries++;
+    return 0;
+}
+
+/*
+ * Copy the hashes next to the bucket positions: a search then scans each
+ * bucket sequentially and only follows positions for actual matches.
+ */
+static inline int easy_phash_index_fill_buckets(EasyPHashIndex *idx)
+{
+    for (int c = 0; c < EASY_PHASH_CHUNKS; c++) {
+        av_freep(&idx->bucket_hashes[c]);
+        idx->bucket_hashes[c] = (uint64_t *)av_malloc_array(FFMAX(idx->nb_indexed, 1), sizeof(uint64_t));
+        if (!idx->bucket_hashes[c]) {
+            idx->nb_indexed = 0;
+            return AVERROR(ENOMEM);
+        }
+        for (int64_t p = 0; p < idx->nb_indexed; p++)
+            idx->bucket_hashes[c][p] = idx->hashes[idx->positions[c][p]];
+    }
+    return 0;
+}
+
+/**
+ * (Re)build the buckets over every entry, a counting sort per chunk.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_phash_index_build(EasyPHashIndex *idx)
+{
+    for (int c = 0; c < EASY_PHASH_CHUNKS; c++) {
+        uint32_t *offsets, *positions;
+
+        av_freep(&idx->offsets[c]);
+        av_freep(&idx->positions[c]);
+        av_freep(&idx->bucket_hashes[c]);
+        offsets   = (uint32_t *)av_calloc(EASY_PHASH_CHUNK_VALUES + 1, sizeof(*offsets));
+        positions = (uint32_t *)av_malloc_array(FFMAX(idx->nb_entries, 1), sizeof(*positions));
+        idx->offsets[c]   = offsets;
+        idx->positions[c] = positions;
+        if (!offsets || !positions) {
+            idx->nb_indexed = 0;
+            return AVERROR(ENOMEM);
+        }
+
+        for (int64_t i = 0; i < idx->nb_entries; i++)
+            offsets[((idx->hashes[i] >> (16 * c)) & 0xffff) + 1]++;
+        for (int v = 0; v < EASY_PHASH_CHUNK_VALUES; v++)
+            offsets[v + 1] += offsets[v];
+        /* offsets[v] is used as the fill cursor of bucket v, then shifted back */
+        for (int64_t i = 0; i < idx->nb_entries; i++)
+            positions[offsets[(idx->hashes[i] >> (16 * c)) & 0xffff]++] = (uint32_t)i;
+        memmove(offsets + 1, offsets, EASY_PHASH_CHUNK_VALUES * sizeof(*offsets));
+        offsets[0] = 0;
+    }
+    idx->nb_indexed = idx->nb_entries;
+    return easy_phash_index_fill_buckets(idx);
+}
+
+/**
+ * Write an index to a file, building it first if entries were added.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_phash_index_write(EasyPHashIndex *idx, const char *filename)
+{
+    EasyPHashIndexHeader header = { { 'E', 'P', 'H', 'I' }, EASY_PHASH_INDEX_VERSION, 0 };
+    size_t n;
+    FILE *f;
+    int ret = 0;
+
+    if ((idx->nb_indexed != idx->nb_entries || !idx->offsets[0]) && (ret = easy_phash_index_build(idx)) < 0)
+        return ret;
+    if (!(f = fopen(filename, "wb"))) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open %s\n", filename);
+        return AVERROR(errno);
+    }
+
+    header.nb_entries = idx->nb_entries;
+    n = (size_t)idx->nb_entries;
+    if (fwrite(&header, sizeof(header), 1, f) != 1 ||
+        fwrite(idx->hashes, sizeof(*idx->hashes), n, f) != n ||
+        fwrite(idx->ids, sizeof(*idx->ids), n, f) != n)
+        ret = AVERROR(EIO);
+    for (int c = 0; c < EASY_PHASH_CHUNKS && ret >= 0; c++)
+        if (fwrite(idx->offsets[c], sizeof(uint32_t), EASY_PHASH_CHUNK_VALUES + 1, f) != EASY_PHASH_CHUNK_VALUES + 1 ||
+            fwrite(idx->positions[c], sizeof(uint32_t), n, f) != n)
+            ret = AVERROR(EIO);
+    if (fclose(f) && ret >= 0)
+        ret = AVERROR(EIO);
+    if (ret < 0)
+        av_log(NULL, AV_LOG_ERROR, "Cannot write %s\n", filename);
+    return ret;
+}
+
+/*
+ * Check the buckets of a loaded index before anything indexes with them:
+ * offsets must start at 0, never decrease and end at n, and every position
+ * must point at an entry whose chunk value is the one of its bucket.
+ */
+static inline int easy_phash_index_check(const EasyPHashIndex *idx, size_t n)
+{
+    for (int c = 0; c < EASY_PHASH_CHUNKS; c++) {
+        const uint32_t *offsets = idx->offsets[c], *positions = idx->positions[c];
+
+        if (offsets[0] || offsets[EASY_PHASH_CHUNK_VALUES] != n)
+            return AVERROR_INVALIDDATA;
+        for (int v = 0; v < EASY_PHASH_CHUNK_VALUES; v++) {
+            if (offsets[v + 1] < offsets[v])
+                return AVERROR_INVALIDDATA;
+            for (uint32_t p = offsets[v]; p < offsets[v + 1]; p++)
+                if (positions[p] >= n || ((idx->hashes[positions[p]] >> (16 * c)) & 0xffff) != (uint64_t)v)
+                    return AVERROR_INVALIDDATA;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Load an index written by easy_phash_index_write(). More hashes can be
+ * added and the index written again. The buckets are validated, a corrupt
+ * or crafted file fails with AVERROR_INVALIDDATA.
+ *
+ * @param idx The index to initialize.
+ * @param filename The index file.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_phash_index_read(EasyPHashIndex *idx, const char *filename)
+{
+    EasyPHashIndexHeader header;
+    size_t n;
+    FILE *f;
+    int ret = 0;
+
+    easy_phash_index_init(idx);
+    if (!(f = fopen(filename, "rb"))) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open %s\n", filename);
+        return AVERROR(errno);
+    }
+    if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, EASY_PHASH_INDEX_MAGIC, 4) ||
+        header.version != EASY_PHASH_INDEX_VERSION || header.nb_entries > UINT32_MAX) {
+        av_log(NULL, AV_LOG_ERROR, "%s is not a perceptual hash index\n", filename);
+        fclose(f);
+        return AVERROR_INVALIDDATA;
+    }
+
+    n = (size_t)header.nb_entries;
+    idx->capacity = FFMAX(n, 1);
+    idx->hashes   = (uint64_t *)av_malloc_array(idx->capacity, sizeof(*idx->hashes));
+    idx->ids      = (uint64_t *)av_malloc_array(idx->capacity, sizeof(*idx->ids));
+    for (int c = 0; c < EASY_PHASH_CHUNKS; c++) {
+        idx->offsets[c]   = (uint32_t *)av_malloc_array(EASY_PHASH_CHUNK_VALUES + 1, sizeof(uint32_t));
+        idx->positions[c] = (uint32_t *)av_malloc_array(idx->capacity, sizeof(uint32_t));
+        if (!idx->offsets[c] || !idx->positions[c])
+            ret = AVERROR(ENOMEM);
+    }
+    if (!idx->hashes || !idx->ids)
+        ret = AVERROR(ENOMEM);
+
+    if (ret >= 0 && (fread(idx->hashes, sizeof(*idx->hashes), n, f) != n ||
+                     fread(idx->ids, sizeof(*idx->ids), n, f) != n))
+        ret = AVERROR_INVALIDDATA;
+    for (int c = 0; c < EASY_PHASH_CHUNKS && ret >= 0; c++)
+        if (fread(idx->offsets[c], sizeof(uint32_t), EASY_PHASH_CHUNK_VALUES + 1, f) != EASY_PHASH_CHUNK_VALUES + 1 ||
+            fread(idx->positions[c], sizeof(uint32_t), n, f) != n)
+            ret = AVERROR_INVALIDDATA;
+    fclose(f);
+    if (ret >= 0)
+        ret = easy_phash_index_check(idx, n);
+
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot read %s\n", filename);
+        easy_phash_index_uninit(idx);
+        return ret;
+    }
+    idx->nb_entries = idx->nb_indexed = n;
+    if ((ret = easy_phash_index_fill_buckets(idx)) < 0)
+        easy_phash_index_uninit(idx);
+    return ret;
+}
+
+/* keep the max_matches closest, matches[0..*nb) is unordered until the end */
+static inline void easy_phash_index_collect(EasyPHashMatch *matches, int max_matches, int *nb,
+                                            uint64_t hash, uint64_t id, int distance)
+{
+    int worst = 0;
+
+    if (*nb < max_matches) {
+        matches[*nb].id       = id;
+        matches[*nb].hash     = hash;
+        matches[*nb].distance = distance;
+        (*nb)++;
+        return;
+    }
+    for (int i = 1; i < *nb; i++)
+        if (matches[i].distance > matches[worst].distance)
+            worst = i;
+    if (*nb && distance < matches[worst].distance) {
+        matches[worst].id       = id;
+        matches[worst].hash     = hash;
+        matches[worst].distance = distance;
+    }
+}
+
+static inline int easy_phash_match_cmp(const void *a, const void *b)
+{
+    const EasyPHashMatch *ma = (const EasyPHashMatch *)a, *mb = (const EasyPHashMatch *)b;
+    if (ma->distance != mb->distance)
+        return ma->distance - mb->distance;
+    return (ma->id > mb->id) - (ma->id < mb->id);
+}
+
+/* check every entry of bucket v of chunk c */
+static inline void easy_phash_index_probe(const EasyPHashIndex *idx, int c, unsigned v, uint64_t hash,
+                                          int max_distance, int chunk_radius,
+                                          EasyPHashMatch *matches, int max_matches, int *nb)
+{
+    const uint64_t *bucket = idx->bucket_hashes[c];
+
+    for (uint32_t p = idx->offsets[c][v]; p < idx->offsets[c][v + 1]; p++) {
+        int distance = easy_phash_distance(hash, bucket[p]), seen = 0;
+
+        if (distance > max_distance)
+            continue;
+        /* an entry close enough in an earlier chunk was already reported from there */
+        for (int e = 0; e < c && !seen; e++)
+            seen = easy_phash_distance((hash >> (16 * e)) & 0xffff, (bucket[p] >> (16 * e)) & 0xffff) <= chunk_radius;
+        if (!seen)
+            easy_phash_index_collect(matches, max_matches, nb, bucket[p], idx->ids[idx->positions[c][p]], distance);
+    }
+}
+
+/**
+ * Find the entries within a Hamming distance of a hash.
+ *
+ * Entries added after the last build are compared one by one.
+ *
+ * @param idx The index.
+ * @param hash The query.
+ * @param max_distance The largest distance reported, at most EASY_PHASH_MAX_DISTANCE.
+ *                     Around 10 catches re-encodes and rescales of the same frame.
+ * @param matches Filled with the closest matches, closest first.
+ * @param max_matches The size of matches.
+ *
+ * @return The number of matches, a negative AVERROR code on failure.
+ */
+static inline int easy_phash_index_search(const EasyPHashIndex *idx, uint64_t hash, int max_distance,
+                                          EasyPHashMatch *matches, int max_matches)
+{
+    int r = max_distance / EASY_PHASH_CHUNKS, nb = 0;
+
+    if (max_distance < 0 || max_distance > EASY_PHASH_MAX_DISTANCE || max_matches < 0)
+        return AVERROR(EINVAL);
+
+    for (int c = 0; c < EASY_PHASH_CHUNKS && idx->nb_indexed; c++) {
+        unsigned q = (hash >> (16 * c)) & 0xffff;
+
+        /* every chunk value within r bits of the query chunk, r <= 3 */
+        easy_phash_index_probe(idx, c, q, hash, max_distance, r, matches, max_matches, &nb);
+        for (int i = 0; i < 16 && r >= 1; i++) {
+            easy_phash_index_probe(idx, c, q ^ (1u << i), hash, max_distance, r, matches, max_matches, &nb);
+            for (int j = i + 1; j < 16 && r >= 2; j++) {
+                easy_phash_index_probe(idx, c, q ^ (1u << i) ^ (1u << j), hash, max_distance, r,
+                                       matches, max_matches, &nb);
+                for (int k = j + 1; k < 16 && r >= 3; k++)
+                    easy_phash_index_probe(idx, c, q ^ (1u << i) ^ (1u << j) ^ (1u << k), hash,
+                                           max_distance, r, matches, max_matches, &nb);
+            }
+        }
+    }
+    for (int64_t i = idx->nb_indexed; i < idx->nb_entries; i++) {
+        int distance = easy_phash_distance(hash, idx->hashes[i]);
+        if (distance <= max_distance)
+            easy_phash_index_collect(matches, max_matches, &nb, idx->hashes[i], idx->ids[i], distance);
+    }
+
+    qsort(matches, nb, sizeof(*matches), easy_phash_match_cmp);
+    return nb;
+}
+
+typedef struct EasyPHashVideo {
+    EasyPHasher    *hasher;
+    EasyPHashIndex *idx;
+    uint64_t        video_id;
+} EasyPHashVideo;
+
+static inline int easy_phash_video_cb(const AVFrame *frame, int index, double timestamp, void *opaque)
+{
+    EasyPHashVideo *v = (EasyPHashVideo *)opaque;
+    uint64_t hash;
+    int ret;
+    (void)timestamp;
+
+    EASY_TRACE_CALL("phash", ret = easy_phash_frame(v->hasher, frame, &hash));
+    if (ret < 0)
+        return ret;
+    return easy_phash_index_add(v->idx, hash, v->video_id << 32 | (uint32_t)index);
+}
+
+/**
+ * Hash a video every interval seconds and add the hashes to an index, with
+ * id video_id << 32 | sample number.
+ *
+ * @param idx The index.
+ * @param filename The video.
+ * @param interval The seconds between samples.
+ * @param video_id The id of the video in the corpus.
+ *
+ * @return The number of hashes added, a negative AVERROR code on failure.
+ */
+static inline int easy_phash_index_add_video(EasyPHashIndex *idx, const char *filename, double interval,
+                                             uint32_t video_id)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    AVCodecContext *dec_ctx = NULL;
+    EasyPHasher hasher;
+    EasyPHashVideo v = { &hasher, idx, video_id };
+    EasyVideoOptions opts = { 0 };
+    double *timestamps = NULL, duration;
+    int64_t before = idx->nb_entries;
+    int stream_index, nb, ret;
+
+    if (interval <= 0)
+        return AVERROR(EINVAL);
+    /* chroma is never looked at */
+    opts.luma_only = 1;
+    if ((ret = easy_open_video2(filename, &fmt_ctx, &dec_ctx, &stream_index, &opts)) < 0)
+        goto end;
+
+    duration = fmt_ctx->duration != AV_NOPTS_VALUE ? fmt_ctx->duration / (double)AV_TIME_BASE : 0;
+    nb = FFMAX(1, (int)(duration / interval));
+    if (!(timestamps = (double *)av_malloc_array(nb, sizeof(*timestamps)))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (int i = 0; i < nb; i++)
+        timestamps[i] = i * interval;
+
+    easy_phash_init(&hasher);
+    ret = easy_sample_frames(fmt_ctx, dec_ctx, stream_index, timestamps, nb, easy_phash_video_cb, &v, NULL);
+    easy_phash_uninit(&hasher);
+
+end:
+    av_free(timestamps);
+    avcodec_free_context(&dec_ctx);
+    avformat_close_input(&fmt_ctx);
+    return ret < 0 ? ret : (int)(idx->nb_entries - before);
+}
+
+#endif // __EASY_PHASH_H__
@@ -0,0 +1,316 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_SAMPLER_H__
+#define __EASY_SAMPLER_H__
+
+#include "easy_common.h"
+#include "easy_trace.h"
+
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/mathematics.h>
+#include <libavutil/mem.h>
+
+#include <stdlib.h>
+
+/* a seek plus decoder flush costs about as much as decoding this many frames */
+#define EASY_SAMPLER_SEEK_COST   8
+/* frames further than this from the next target are not output, so
+ * non-reference frames can be skipped without losing a nearest candidate */
+#define EASY_SAMPLER_SKIP_MARGIN 16
+/* keyframe interval assumed for inputs without an index until one is seen */
+#define EASY_SAMPLER_DEFAULT_GOP 250
+
+/**
+ * Called with the decoded frame nearest to one requested timestamp.
+ *
+ * @param frame The frame, only valid during the call.
+ * @param index The position of the timestamp in the list given to easy_sample_frames().
+ * @param timestamp The requested timestamp in seconds.
+ * @param opaque The pointer passed to easy_sample_frames().
+ *
+ * @return 0 to continue, a negative value to stop sampling with that error.
+ */
+typedef int (*EasySampleCallback)(const AVFrame *frame, int index, double timestamp, void *opaque);
+
+/**
+ * What easy_sample_frames() did, to compare against a full decode.
+ */
+typedef struct EasySamplerStats {
+    int     seeks;
+    int64_t packets;  ///< packets of the sampled stream sent to the decoder
+    int64_t frames;   ///< frames the decoder output
+    int     samples;  ///< callbacks made
+} EasySamplerStats;
+
+typedef struct EasySampleTarget {
+    int64_t pts;      ///< requested time in the stream time base
+    double  seconds;
+    int     index;
+} EasySampleTarget;
+
+typedef struct EasySampler {
+    AVFormatContext  *fmt_ctx;
+    AVCodecContext   *dec_ctx;
+    AVStream         *st;
+    int               stream_index;
+    EasySampleTarget *targets;
+    int               nb_targets;
+    int               next;          ///< first target not delivered yet
+    int               seeked_for;    ///< target the last seek was made for
+    AVFrame          *prev;          ///< last decoded frame, the candidate before the target
+    int64_t           prev_pts;
+    int64_t           pos;           ///< decoding position for planning, in the stream time base
+    int64_t           frame_duration;
+    int64_t           gop;           ///< largest keyframe interval seen
+    int               gop_known;
+    int64_t           last_key;
+    EasySampleCallback cb;
+    void             *opaque;
+    EasySamplerStats  stats;
+} EasySampler;
+
+static inline int easy_sampler_cmp(const void *a, const void *b)
+{
+    const EasySampleTarget *ta = (const EasySampleTarget *)a, *tb = (const EasySampleTarget *)b;
+    if (ta->pts != tb->pts)
+        return ta->pts < tb->pts ? -1 : 1;
+    return ta->index - tb->index;
+}
+
+/* pts of the last indexed keyframe at or before ts, AV_NOPTS_VALUE without an index */
+static inline int64_t easy_sampler_keyframe_before(EasySampler *s, int64_t ts)
+{
+#if LIBAVFORMAT_VERSION_INT >= AV_VERSION_INT(58, 78, 100)
+    const AVIndexEntry *e = avformat_index_get_entry_from_timestamp(s->st, ts, AVSEEK_FLAG_BACKWARD);
+    return e ? e->timestamp : AV_NOPTS_VALUE;
+#else
+    int idx = av_index_search_timestamp(s->st, ts, AVSEEK_FLAG_BACKWARD);
+    return idx >= 0 ? s->st->index_entries[idx].timestamp : AV_NOPTS_VALUE;
+#endif
+}
+
+/*
+ * Seek when decoding forward to the next target would cost more than seeking
+ * to its keyframe and decoding from there. Targets within the GOP being
+ * decoded are always reached by decoding forward.
+ */
+static inline int easy_sampler_plan(EasySampler *s)
+{
+    const EasySampleTarget *t = &s->targets[s->next];
+    int64_t key = easy_sampler_keyframe_before(s, t->pts);
+    int64_t skipped;
+    int ret;
+
+    if (s->seeked_for == s->next || t->pts <= s->pos)
+        return 0;
+
+    /* decode time saved by the seek: everything between here and the keyframe */
+    if (key != AV_NOPTS_VALUE)
+        skipped = key - s->pos;
+    else
+        skipped = t->pts - s->gop - s->pos;
+    if (skipped <= EASY_SAMPLER_SEEK_COST * s->frame_duration)
+        return 0;
+
+    ret = avformat_seek_file(s->fmt_ctx, s->stream_index, INT64_MIN, t->pts, t->pts, 0);
+    if (ret < 0)
+        ret = av_seek_frame(s->fmt_ctx, s->stream_index, t->pts, AVSEEK_FLAG_BACKWARD);
+    if (ret < 0)
+        return 0; // not seekable, decode forward instead
+
+    /* prev stays, it is still the frame to give if the seek lands past the end */
+    avcodec_flush_buffers(s->dec_ctx);
+    s->last_key   = AV_NOPTS_VALUE;
+    s->pos        = key != AV_NOPTS_VALUE ? key : t->pts - s->gop;
+    s->seeked_for = s->next;
+    s->stats.seeks++;
+    return 0;
+}
+
+/* deliver every pending target the new frame is past, picking the nearer of
+ * the previous and the new frame */
+static inline int easy_sampler_frame(EasySampler *s, AVFrame *frame)
+{
+    int64_t pts = frame->best_effort_timestamp;
+    int ret;
+
+    if (pts == AV_NOPTS_VALUE)
+        pts = s->prev_pts != AV_NOPTS_VALUE ? s->prev_pts + s->frame_duration : s->pos;
+    s->stats.frames++;
+
+    while (s->next < s->nb_targets && pts >= s->targets[s->next].pts) {
+        const EasySampleTarget *t = &s->targets[s->next];
+        const AVFrame *best = frame;
+
+        if (s->prev_pts != AV_NOPTS_VALUE && t->pts - s->prev_pts <= pts - t->pts)
+            best = s->prev;
+        if ((ret = s->cb(best, t->index, t->seconds, s->opaque)) < 0)
+            return ret;
+        s->stats.samples++;
+        s->next++;
+    }
+
+    av_frame_unref(s->prev);
+    av_frame_move_ref(s->prev, frame);
+    s->prev_pts = pts;
+    s->pos      = FFMAX(s->pos, pts);
+    return 0;
+}
+
+static inline int easy_sampler_receive(EasySampler *s, AVFrame *frame)
+{
+    int ret;
+
+    while ((ret = easy_receive_frame(s->dec_ctx, frame)) >= 0) {
+        if ((ret = easy_sampler_frame(s, frame)) < 0)
+            return ret;
+        av_frame_unref(frame);
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ? 0 : ret;
+}
+
+/**
+ * Decode the frames nearest to a list of timestamps.
+ *
+ * Timestamps are sorted, then each gap between consecutive targets is
+ * either decoded through or skipped with a seek to the keyframe before the
+ * next target, whichever decodes fewer frames according to the stream index
+ * (or the keyframe spacing seen so far when the input has no index).
+ * Targets within one GOP therefore share a single seek. Non-reference
+ * frames far from any target are not decoded at all.
+ *
+ * @param fmt_ctx The opened input, it is seeked.
+ * @param dec_ctx The opened decoder of the stream.
+ * @param stream_index The index of the video stream.
+ * @param timestamps The requested times in seconds from the start of the stream, in any order.
+ * @param nb_timestamps The number of timestamps.
+ * @param cb Called once per timestamp, in time order, with the nearest frame.
+ * @param opaque Passed to cb.
+ * @param stats Filled with what the sampler did, may be NULL.
+ *
+ * @note Timestamps past the last frame get the last frame.
+ *
+ * @return 0 on success, a negative AVERROR code or the error of cb on failure.
+ */
+static inline int easy_sample_frames(AVFormatContext *fmt_ctx, AVCodecContext *dec_ctx, int stream_index,
+                                     const double *timestamps, int nb_timestamps,
+                                     EasySampleCallback cb, void *opaque, EasySamplerStats *stats)
+{
+    EasySampler s = { 0 };
+    enum AVDiscard skip_frame = dec_ctx->skip_frame;
+    AVPacket *pkt = NULL;
+    AVFrame *frame = NULL;
+    int64_t start;
+    int ret = 0;
+
+    s.fmt_ctx      = fmt_ctx;
+    s.dec_ctx      = dec_ctx;
+    s.stream_index = stream_index;
+    s.st           = fmt_ctx->streams[stream_index];
+    s.nb_targets   = nb_timestamps;
+    s.seeked_for   = -1;
+    s.prev_pts     = AV_NOPTS_VALUE;
+    s.last_key     = AV_NOPTS_VALUE;
+    s.cb           = cb;
+    s.opaque       = opaque;
+
+    if (!nb_timestamps)
+        goto end;
+
+    s.targets = (EasySampleTarget *)av_malloc_array(nb_timestamps, sizeof(*s.targets));
+    s.prev    = av_frame_alloc();
+    frame     = av_frame_alloc();
+    pkt       = av_packet_alloc();
+    if (!s.targets || !s.prev || !frame || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    start = s.st->start_time != AV_NOPTS_VALUE ? s.st->start_time : 0;
+    for (int i = 0; i < nb_timestamps; i++) {
+        s.targets[i].pts     = start + av_rescale_q((int64_t)(timestamps[i] * AV_TIME_BASE), AV_TIME_BASE_Q,
+                                                    s.st->time_base);
+        s.targets[i].seconds = timestamps[i];
+        s.targets[i].index   = i;
+    }
+    qsort(s.targets, nb_timestamps, sizeof(*s.targets), easy_sampler_cmp);
+
+    if (s.st->avg_frame_rate.num && s.st->avg_frame_rate.den)
+        s.frame_duration = av_rescale_q(1, av_inv_q(s.st->avg_frame_rate), s.st->time_base);
+    s.frame_duration = FFMAX(s.frame_duration, 1);
+    s.gop = EASY_SAMPLER_DEFAULT_GOP * s.frame_duration;
+    s.pos = start; // the input is expected at its start
+
+    while (s.next < s.nb_targets) {
+        if ((ret = easy_sampler_plan(&s)) < 0)
+            goto end;
+
+        if ((ret = easy_read_frame(fmt_ctx, pkt)) < 0)
+            break;
+        if (pkt->stream_index != stream_index) {
+            av_packet_unref(pkt);
+            continue;
+        }
+
+        if (pkt->flags & AV_PKT_FLAG_KEY && pkt->pts != AV_NOPTS_VALUE) {
+            /* only consecutive keyframes, a seek in between would hide the ones skipped */
+            if (s.last_key != AV_NOPTS_VALUE && pkt->pts > s.last_key) {
+                s.gop       = s.gop_known ? FFMAX(s.gop, pkt->pts - s.last_key) : pkt->pts - s.last_key;
+                s.gop_known = 1;
+            }
+            s.last_key = pkt->pts;
+        }
+        /* far from the next target only reference frames matter */
+        dec_ctx->skip_frame = pkt->dts != AV_NOPTS_VALUE &&
+                              s.targets[s.next].pts - pkt->dts > EASY_SAMPLER_SKIP_MARGIN * s.frame_duration
+                              ? (enum AVDiscard)FFMAX(skip_frame, AVDISCARD_NONREF) : skip_frame;
+
+        ret = easy_send_packet(dec_ctx, pkt);
+        av_packet_unref(pkt);
+        s.stats.packets++;
+        if (ret < 0 && ret != AVERROR_INVALIDDATA)
+            goto end;
+        if ((ret = easy_sampler_receive(&s, frame)) < 0)
+            goto end;
+    }
+
+    if (ret < 0 && ret != AVERROR_EOF)
+        goto end;
+    ret = 0;
+
+    if (s.next < s.nb_targets) {
+        /* drain the decoder, then the last frame is the nearest to what is left */
+        dec_ctx->skip_frame = skip_frame;
+        if ((ret = easy_send_packet(dec_ctx, NULL)) >= 0 && (ret = easy_sampler_receive(&s, frame)) < 0)
+            goto end;
+        ret = 0;
+        for (; s.next < s.nb_targets && s.prev_pts != AV_NOPTS_VALUE; s.next++, s.stats.samples++)
+            if ((ret = cb(s.prev, s.targets[s.next].index, s.targets[s.next].seconds, opaque)) < 0)
+                goto end;
+    }
+
+end:
+    dec_ctx->skip_frame = skip_frame;
+    if (stats)
+        *stats = s.stats;
+    av_packet_free(&pkt);
+    av_frame_free(&frame);
+    av_frame_free(&s.prev);
+    av_freep(&s.targets);
+    return ret;
+}
+
+#endif // __EASY_SAMPLER_H__
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_SCENE_H__
+#define __EASY_SCENE_H__
+
+#include "easy_common.h"
+#include "easy_kernels.h"
+
+#include <libavutil/frame.h>
+#include <libavutil/mem.h>
+#include <libavutil/pixdesc.h>
+
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define EASY_SCENE_BLOCK      8  // luma is averaged over 8x8 blocks before scoring
+#define EASY_SCENE_HIST_BINS  64
+
+/* defaults tuned for slide decks and static surveillance cameras */
+#define EASY_SCENE_DEFAULT_SAD_THRESHOLD  3.0
+#define EASY_SCENE_DEFAULT_HIST_THRESHOLD 0.15
+
+/**
+ * Scores frames against the last distinct frame on a 1/8 x 1/8 luma thumbnail.
+ *
+ * Two measures are computed: the mean absolute difference of the thumbnails
+ * (catches motion and local changes) and the L1 distance of their
+ * normalized histograms (catches global brightness and cut changes).
+ */
+typedef struct EasySceneDetector {
+    int      width, height;              ///< luma size the thumbnails were built for
+    int      thumb_width, thumb_height;  ///< thumbnail size in blocks
+    int      thumb_linesize;             ///< thumbnail row size, padded with zeros to 32 bytes
+    uint8_t *thumb[2];                   ///< current and last distinct thumbnail
+    uint32_t hist[2][EASY_SCENE_HIST_BINS];
+    int      cur;                        ///< index of the current thumbnail
+    int      has_prev;
+
+    double   sad_threshold;              ///< mean absolute thumbnail difference, 0-255
+    double   hist_threshold;             ///< normalized histogram distance, 0-2
+
+    double   sad;                        ///< score of the last frame
+    double   hist_distance;              ///< histogram distance of the last frame
+} EasySceneDetector;
+
+/**
+ * Initialize a scene change detector.
+ *
+ * @param det The detector to initialize.
+ * @param sad_threshold Frames whose mean thumbnail difference exceeds this are distinct.
+ * @param hist_threshold Frames whose histogram distance exceeds this are distinct.
+ */
+static inline void easy_scene_init(EasySceneDetector *det, double sad_threshold, double hist_threshold)
+{
+    memset(det, 0, sizeof(*det));
+    det->sad_threshold  = sad_threshold;
+    det->hist_threshold = hist_threshold;
+}
+
+/**
+ * Free the thumbnails of a scene change detector.
+ */
+static inline void easy_scene_uninit(EasySceneDetector *det)
+{
+    av_freep(&det->thumb[0]);
+    av_freep(&det->thumb[1]);
+}
+
+/**
+ * Average every 8x8 block of a luma plane into one thumbnail pixel.
+ */
+static inline void easy_scene_downsample(const uint8_t *y, int y_linesize, int thumb_width, int thumb_height,
+                                         uint8_t *thumb, int thumb_linesize)
+{
+    for (int by = 0; by < thumb_height; by++) {
+        const uint8_t *src = y + (ptrdiff_t)by * EASY_SCENE_BLOCK * y_linesize;
+        uint8_t *dst = thumb + (ptrdiff_t)by * thumb_linesize;
+        int bx = 0;
+
+#if defined(__SSE2__)
+        /* psadbw against zero sums 8 bytes per lane, i.e. one block row per lane */
+        const __m128i zero = _mm_setzero_si128();
+        for (; bx + 2 <= thumb_width; bx += 2) {
+            __m128i sum = zero;
+            for (int r = 0; r < EASY_SCENE_BLOCK; r++) {
+                __m128i row = _mm_loadu_si128((const __m128i *)(src + (ptrdiff_t)r * y_linesize + bx * EASY_SCENE_BLOCK));
+                sum = _mm_add_epi64(sum, _mm_sad_epu8(row, zero));
+            }
+            dst[bx]     = (uint8_t)((_mm_cvtsi128_si32(sum) + 32) >> 6);
+            dst[bx + 1] = (uint8_t)((_mm_cvtsi128_si32(_mm_srli_si128(sum, 8)) + 32) >> 6);
+        }
+#endif
+        for (; bx < thumb_width; bx++) {
+            unsigned sum = 0;
+            for (int r = 0; r < EASY_SCENE_BLOCK; r++)
+                for (int c = 0; c < EASY_SCENE_BLOCK; c++)
+                    sum += src[(ptrdiff_t)r * y_linesize + bx * EASY_SCENE_BLOCK + c];
+            dst[bx] = (uint8_t)((sum + 32) >> 6);
+        }
+    }
+}
+
+/**
+ * Sum of absolute differences of two equally sized 8-bit planes.
+ *
+ * @note Rows are processed 16 bytes at a time, so linesize must be a multiple
+ *       of 16 and the padding past width must be equal in both planes.
+ */
+static inline uint64_t easy_scene_sad_plane(const uint8_t *a, const uint8_t *b, int linesize, int width, int height)
+{
+    uint64_t total = 0;
+
+#if defined(EASY_HAVE_KERNELS)
+    total = easy_kernel_sad_plane(a, linesize, b, linesize, width, height);
+#elif defined(__SSE2__)
+    for (int j = 0; j < height; j++) {
+        const uint8_t *ra = a + (ptrdiff_t)j * linesize;
+        const uint8_t *rb = b + (ptrdiff_t)j * linesize;
+        __m128i sum = _mm_setzero_si128();
+
+        for (int i = 0; i < width; i += 16)
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(ra + i)),
+                                                  _mm_loadu_si128((const __m128i *)(rb + i))));
+        total += (uint64_t)_mm_cvtsi128_si32(sum) + (uint64_t)_mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+    }
+#else
+    for (int j = 0; j < height; j++) {
+        const uint8_t *ra = a + (ptrdiff_t)j * linesize;
+        const uint8_t *rb = b + (ptrdiff_t)j * linesize;
+
+        for (int i = 0; i < width; i++)
+            total += ra[i] > rb[i] ? ra[i] - rb[i] : rb[i] - ra[i];
+    }
+#endif
+    return total;
+}
+
+/**
+ * Score a luma plane against the last distinct one.
+ *
+ * @param det The detector.
+ * @param y The pointer to the Y plane data.
+ * @param y_linesize The number of bytes in a row of the Y plane.
+ * @param width The width of the image in pixels.
+ * @param height The height of the image in pixels.
+ *
+ * @return 1 if the frame is distinct from the last distinct frame (always
+ *         true for the first frame and after a resolution change), 0 if it is
+ *         a near duplicate, a negative AVERROR code on failure.
+ */
+static inline int easy_scene_score(EasySceneDetector *det, const uint8_t *y, int y_linesize, int width, int height)
+{
+    uint32_t *hist;
+    int prev, pixels;
+
+    if (width < 2 * EASY_SCENE_BLOCK || height < EASY_SCENE_BLOCK)
+        return AVERROR(EINVAL);
+
+    if (width != det->width || height != det->height) {
+        easy_scene_uninit(det);
+        det->width          = width;
+        det->height         = height;
+        det->thumb_width    = width / EASY_SCENE_BLOCK;
+        det->thumb_height   = height / EASY_SCENE_BLOCK;
+        det->thumb_linesize = FFALIGN(det->thumb_width, 32);
+        det->thumb[0] = (uint8_t *)av_mallocz((size_t)det->thumb_linesize * det->thumb_height);
+        det->thumb[1] = (uint8_t *)av_mallocz((size_t)det->thumb_linesize * det->thumb_height);
+        det->has_prev = 0;
+        if (!det->thumb[0] || !det->thumb[1]) {
+            easy_scene_uninit(det);
+            det->width = det->height = 0;
+            return AVERROR(ENOMEM);
+        }
+    }
+
+    prev = det->cur;
+    det->cur ^= 1;
+    easy_scene_downsample(y, y_linesize, det->thumb_width, det->thumb_height,
+                          det->thumb[det->cur], det->thumb_linesize);
+
+    hist = det->hist[det->cur];
+    memset(hist, 0, sizeof(det->hist[0]));
+    for (int j = 0; j < det->thumb_height; j++) {
+        const uint8_t *row = det->thumb[det->cur] + (ptrdiff_t)j * det->thumb_linesize;
+        for (int i = 0; i < det->thumb_width; i++)
+            hist[row[i] >> 2]++;
+    }
+
+    if (!det->has_prev) {
+        det->has_prev      = 1;
+        det->sad           = 255.0;
+        det->hist_distance = 2.0;
+        return 1;
+    }
+
+    pixels = det->thumb_width * det->thumb_height;
+    det->sad = (double)easy_scene_sad_plane(det->thumb[det->cur], det->thumb[prev], det->thumb_linesize,
+                                            det->thumb_width, det->thumb_height) / pixels;
+    det->hist_distance = 0;
+    for (int i = 0; i < EASY_SCENE_HIST_BINS; i++) {
+        int d = (int)hist[i] - (int)det->hist[prev][i];
+        det->hist_distance += d < 0 ? -d : d;
+    }
+    det->hist_distance /= pixels;
+
+    if (det->sad > det->sad_threshold || det->hist_distance > det->hist_threshold)
+        return 1;
+
+    /* keep comparing against the last distinct frame, so a slow drift is
+     * reported once it adds up instead of slipping through frame by frame */
+    det->cur = prev;
+    return 0;
+}
+
+/**
+ * Check whether a decoded frame differs enough from the last distinct one
+ * to be kept, see easy_scene_score().
+ *
+ * @return As easy_scene_score(), AVERROR(EINVAL) for formats without an
+ *         8-bit luma plane of their own (RGB, packed YUV, high bit depth).
+ */
+static inline int easy_scene_is_distinct(EasySceneDetector *det, const AVFrame *frame)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+
+    if (!desc || (desc->flags & AV_PIX_FMT_FLAG_RGB) || desc->comp[0].depth != 8 ||
+        desc->comp[0].plane != 0 || desc->comp[0].step != 1)
+        return AVERROR(EINVAL);
+    return easy_scene_score(det, frame->data[0], frame->linesize[0], frame->width, frame->height);
+}
+
+#endif // __EASY_SCENE_H__
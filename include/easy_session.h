@@ -0,0 +1,444 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_SESSION_H__
+#define __EASY_SESSION_H__
+
+#include "easy_common.h"
+#include "easy_media.h"
+#include "easy_memory.h"
+#include "easy_thread.h"
+#include "easy_trace.h"
+
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+
+#include <pthread.h>
+
+#define EASY_SESSION_PACKET_QUEUE_SIZE 64
+#define EASY_SESSION_FRAME_QUEUE_SIZE  8
+
+/**
+ * Options for easy_av_session_open(). Zero-initialize it and set only the
+ * fields you need.
+ */
+typedef struct EasyAVSessionOptions {
+    int            disable_video;      ///< do not decode the video stream
+    int            disable_audio;      ///< do not decode the audio stream
+    int            frame_queue_size;   ///< decoded frames buffered per stream, 0 for the default
+    EasyMemBudget *budget;             ///< charge decoded frames against this budget, may be NULL
+    int            live;               ///< low-latency input from a pipe, FIFO or stdin, see easy_open_input()
+} EasyAVSessionOptions;
+
+/**
+ * One decoded stream of a session, owned by its decoder thread.
+ */
+typedef struct EasyAVSessionStream {
+    struct EasyAVSession *session;
+    AVCodecContext       *dec_ctx;      ///< NULL if the stream is not decoded
+    int                   stream_index; ///< -1 if the stream is not decoded
+    EasyFifo              packets;      ///< demuxer -> decoder
+    EasyFifo              frames;       ///< decoder -> consumer
+    pthread_t             thread;
+    int                   thread_started;
+} EasyAVSessionStream;
+
+/**
+ * A demuxer thread feeding separate audio and video decoder threads.
+ *
+ * The input is read exactly once, each packet is routed to the queue of its
+ * stream and both decoders run in parallel, each with its own codec. Decoded
+ * frames are delivered through per-stream queues.
+ */
+typedef struct EasyAVSession {
+    AVFormatContext     *fmt_ctx;
+    EasyAVSessionStream  video;
+    EasyAVSessionStream  audio;
+    EasyMemBudget       *budget;
+    int                  live;
+    pthread_t            demux_thread;
+    int                  demux_started;
+    pthread_mutex_t      lock;          ///< protects error
+    int                  error;         ///< first error hit by a pipeline thread
+    int                  closing;       ///< stops budget waits of this session only, under the budget lock
+    int                  interrupted;   ///< atomic, makes blocking demuxer I/O return, see easy_session_interrupt()
+} EasyAVSession;
+
+static inline void easy_session_free_packet(void *item_ptr)
+{
+    av_packet_free((AVPacket **)item_ptr);
+}
+
+static inline void easy_session_free_frame(void *item_ptr)
+{
+    av_frame_free((AVFrame **)item_ptr);
+}
+
+/* Open the decoder of the best stream of a type, missing streams are not an error. */
+static inline int easy_session_open_stream(EasyAVSession *session, EasyAVSessionStream *st,
+                                           enum AVMediaType type, int related, int frame_queue_size)
+{
+    const AVCodec *dec;
+    int ret;
+
+    st->session      = session;
+    st->stream_index = -1;
+
+    ret = av_find_best_stream(session->fmt_ctx, type, -1, related, &dec, 0);
+    if (ret == AVERROR_STREAM_NOT_FOUND)
+        return 0;
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find a decoder for the %s stream\n", av_get_media_type_string(type));
+        return ret;
+    }
+    st->stream_index = ret;
+
+    st->dec_ctx = avcodec_alloc_context3(dec);
+    if (!st->dec_ctx)
+        return AVERROR(ENOMEM);
+    avcodec_parameters_to_context(st->dec_ctx, session->fmt_ctx->streams[st->stream_index]->codecpar);
+    st->dec_ctx->pkt_timebase = session->fmt_ctx->streams[st->stream_index]->time_base;
+    if (session->live)
+        easy_codec_set_low_delay(st->dec_ctx);
+
+    if ((ret = avcodec_open2(st->dec_ctx, dec, NULL)) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open %s decoder\n", av_get_media_type_string(type));
+        return ret;
+    }
+
+    if ((ret = easy_fifo_init(&st->packets, EASY_SESSION_PACKET_QUEUE_SIZE)) < 0)
+        return ret;
+    return easy_fifo_init(&st->frames, frame_queue_size);
+}
+
+static inline void easy_session_set_error(EasyAVSession *session, int err)
+{
+    pthread_mutex_lock(&session->lock);
+    if (err < 0 && err != AVERROR_EOF && err != AVERROR_EXIT && !session->error)
+        session->error = err;
+    pthread_mutex_unlock(&session->lock);
+}
+
+static inline int easy_session_get_error(EasyAVSession *session)
+{
+    int err;
+
+    pthread_mutex_lock(&session->lock);
+    err = session->error;
+    pthread_mutex_unlock(&session->lock);
+    return err;
+}
+
+/* Move every frame the decoder has ready to the output queue. */
+static inline int easy_session_drain_decoder(EasyAVSessionStream *st, AVFrame *frame)
+{
+    int ret;
+
+    while ((ret = easy_receive_frame(st->dec_ctx, frame)) >= 0) {
+        AVFrame *out;
+
+        if (st->session->budget &&
+            (ret = easy_mem_budget_track_frame2(st->session->budget, frame, EASY_MEM_WAIT,
+                                                &st->session->closing)) < 0) {
+            av_frame_unref(frame);
+            return ret;
+        }
+        out = av_frame_alloc();
+        if (!out) {
+            av_frame_unref(frame);
+            return AVERROR(ENOMEM);
+        }
+        av_frame_move_ref(out, frame);
+        if ((ret = easy_fifo_push(&st->frames, out)) < 0) {
+            av_frame_free(&out);
+            return ret;
+        }
+    }
+    return ret == AVERROR(EAGAIN) ? 0 : ret;
+}
+
+static inline void *easy_session_decode_thread(void *arg)
+{
+    EasyAVSessionStream *st = (EasyAVSessionStream *)arg;
+    AVFrame *frame = av_frame_alloc();
+    AVPacket *pkt;
+    int ret = frame ? 0 : AVERROR(ENOMEM);
+
+    easy_trace_thread_name(st->dec_ctx->codec_type == AVMEDIA_TYPE_VIDEO ? "video decode" : "audio decode");
+    while (ret >= 0 && (ret = easy_fifo_pop(&st->packets, (void **)&pkt)) >= 0) {
+        ret = easy_send_packet(st->dec_ctx, pkt);
+        av_packet_free(&pkt);
+        if (ret == AVERROR_INVALIDDATA) {
+            av_log(NULL, AV_LOG_WARNING, "Skipping corrupt %s packet\n",
+                   av_get_media_type_string(st->dec_ctx->codec_type));
+            ret = 0;
+            continue;
+        }
+        if (ret >= 0)
+            ret = easy_session_drain_decoder(st, frame);
+    }
+
+    if (ret == AVERROR_EOF) {
+        /* flush the decoder */
+        ret = easy_send_packet(st->dec_ctx, NULL);
+        if (ret >= 0)
+            ret = easy_session_drain_decoder(st, frame);
+    }
+    /* nobody pops the packets anymore, make the demuxer stop instead of
+     * blocking on the full queue and starving the other stream */
+    if (ret < 0 && ret != AVERROR_EOF)
+        easy_fifo_abort(&st->packets);
+    easy_session_set_error(st->session, ret);
+    easy_fifo_finish(&st->frames);
+    av_frame_free(&frame);
+    return NULL;
+}
+
+/* AVIOInterruptCB of the input, lets close stop a read blocked on a pipe */
+static inline int easy_session_interrupt(void *opaque)
+{
+    return EASY_ATOMIC_LOAD(&((EasyAVSession *)opaque)->interrupted);
+}
+
+static inline void *easy_session_demux_thread(void *arg)
+{
+    EasyAVSession *session = (EasyAVSession *)arg;
+    AVPacket *pkt = NULL;
+    int ret = 0;
+
+    easy_trace_thread_name("demux");
+    while (ret >= 0) {
+        EasyAVSessionStream *st = NULL;
+
+        if (!pkt && !(pkt = av_packet_alloc())) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        if ((ret = easy_read_frame(session->fmt_ctx, pkt)) < 0)
+            break;
+
+        if (pkt->stream_index == session->video.stream_index)
+            st = &session->video;
+        else if (pkt->stream_index == session->audio.stream_index)
+            st = &session->audio;
+
+        if (!st) {
+            av_packet_unref(pkt);
+            continue;
+        }
+        /* the queue takes ownership, a new packet is allocated for the next read */
+        if ((ret = easy_fifo_push(&st->packets, pkt)) < 0)
+            break;
+        pkt = NULL;
+    }
+
+    easy_session_set_error(session, ret);
+    av_packet_free(&pkt);
+    if (session->video.dec_ctx)
+        easy_fifo_finish(&session->video.packets);
+    if (session->audio.dec_ctx)
+        easy_fifo_finish(&session->audio.packets);
+    return NULL;
+}
+
+/**
+ * Close a session, stop its threads and free everything it owns.
+ *
+ * @param session A pointer to the session, set to NULL on return.
+ */
+static inline void easy_av_session_close(EasyAVSession **session)
+{
+    EasyAVSession *s = *session;
+    EasyAVSessionStream *streams[2];
+
+    if (!s)
+        return;
+    streams[0] = &s->video;
+    streams[1] = &s->audio;
+
+    EASY_ATOMIC_STORE(&s->interrupted, 1);
+    for (int i = 0; i < 2; i++) {
+        if (streams[i]->packets.items)
+            easy_fifo_abort(&streams[i]->packets);
+        if (streams[i]->frames.items) {
+            easy_fifo_abort(&streams[i]->frames);
+            /* refund queued frames so a decoder waiting on the budget wakes up */
+            easy_fifo_flush(&streams[i]->frames, easy_session_free_frame);
+        }
+    }
+    /* the budget may be shared with other pipelines, whose frames can keep it
+     * full for good: wake our decoders without aborting it for everyone */
+    if (s->budget)
+        easy_mem_budget_cancel(s->budget, &s->closing);
+
+    if (s->demux_started)
+        pthread_join(s->demux_thread, NULL);
+    for (int i = 0; i < 2; i++) {
+        if (streams[i]->thread_started)
+            pthread_join(streams[i]->thread, NULL);
+        easy_fifo_uninit(&streams[i]->packets, easy_session_free_packet);
+        easy_fifo_uninit(&streams[i]->frames, easy_session_free_frame);
+        avcodec_free_context(&streams[i]->dec_ctx);
+    }
+    avformat_close_input(&s->fmt_ctx);
+    pthread_mutex_destroy(&s->lock);
+    av_freep(session);
+}
+
+/**
+ * Open an input file and prepare one decoder per stream type.
+ *
+ * @param session A pointer to a pointer to an EasyAVSession, which will be allocated and initialized.
+ * @param filename The name of the input file.
+ * @param opts The session options, may be NULL.
+ *
+ * @note Both the audio and the video stream are optional, check
+ *       stream_index (or dec_ctx) of each to see which ones were found.
+ *       Call easy_av_session_start() to spawn the threads.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_av_session_open(EasyAVSession **session, const char *filename,
+                                       const EasyAVSessionOptions *opts)
+{
+    int frame_queue_size = opts && opts->frame_queue_size > 0 ? opts->frame_queue_size
+                                                              : EASY_SESSION_FRAME_QUEUE_SIZE;
+    EasyAVSession *s;
+    int ret;
+
+    s = *session = (EasyAVSession *)av_mallocz(sizeof(**session));
+    if (!s)
+        return AVERROR(ENOMEM);
+    if (pthread_mutex_init(&s->lock, NULL)) {
+        av_freep(session);
+        return AVERROR(ENOMEM);
+    }
+    s->budget             = opts ? opts->budget : NULL;
+    s->live               = opts && opts->live;
+    s->video.stream_index = -1;
+    s->audio.stream_index = -1;
+
+    /* allocated up front so the interrupt callback covers opening too */
+    if (!(s->fmt_ctx = avformat_alloc_context())) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    s->fmt_ctx->interrupt_callback.callback = easy_session_interrupt;
+    s->fmt_ctx->interrupt_callback.opaque   = s;
+    if ((ret = easy_open_input(&s->fmt_ctx, filename, s->live)) < 0)
+        goto fail;
+
+    if (!(opts && opts->disable_video) &&
+        (ret = easy_session_open_stream(s, &s->video, AVMEDIA_TYPE_VIDEO, -1, frame_queue_size)) < 0)
+        goto fail;
+    if (!(opts && opts->disable_audio) &&
+        (ret = easy_session_open_stream(s, &s->audio, AVMEDIA_TYPE_AUDIO, s->video.stream_index,
+                                        frame_queue_size)) < 0)
+        goto fail;
+
+    if (!s->video.dec_ctx && !s->audio.dec_ctx) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot find an audio or video stream in the input file\n");
+        ret = AVERROR_STREAM_NOT_FOUND;
+        goto fail;
+    }
+
+    /* let the demuxer drop packets of streams nobody decodes */
+    for (unsigned i = 0; i < s->fmt_ctx->nb_streams; i++)
+        if ((int)i != s->video.stream_index && (int)i != s->audio.stream_index)
+            s->fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+
+    return 0;
+
+fail:
+    easy_av_session_close(session);
+    return ret;
+}
+
+/**
+ * Start the demuxer and decoder threads of a session.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_av_session_start(EasyAVSession *session)
+{
+    EasyAVSessionStream *streams[2] = { &session->video, &session->audio };
+
+    for (int i = 0; i < 2; i++) {
+        if (!streams[i]->dec_ctx)
+            continue;
+        if (pthread_create(&streams[i]->thread, NULL, easy_session_decode_thread, streams[i]))
+            return AVERROR(EAGAIN);
+        streams[i]->thread_started = 1;
+    }
+    if (pthread_create(&session->demux_thread, NULL, easy_session_demux_thread, session))
+        return AVERROR(EAGAIN);
+    session->demux_started = 1;
+
+    return 0;
+}
+
+static inline int easy_session_read_frame(EasyAVSession *session, enum AVMediaType type, AVFrame *frame,
+                                          int block)
+{
+    EasyAVSessionStream *st = type == AVMEDIA_TYPE_VIDEO ? &session->video : &session->audio;
+    AVFrame *out;
+    int ret;
+
+    if (!st->dec_ctx)
+        return AVERROR_STREAM_NOT_FOUND;
+
+    ret = block ? easy_fifo_pop(&st->frames, (void **)&out) : easy_fifo_try_pop(&st->frames, (void **)&out);
+    if (ret == AVERROR_EOF && easy_session_get_error(session))
+        return easy_session_get_error(session);
+    if (ret < 0)
+        return ret;
+
+    av_frame_move_ref(frame, out);
+    av_frame_free(&out);
+    return 0;
+}
+
+/**
+ * Get the next decoded frame of a stream, blocking until one is available.
+ *
+ * @param session The running session.
+ * @param type AVMEDIA_TYPE_VIDEO or AVMEDIA_TYPE_AUDIO.
+ * @param frame The frame to fill, it must be unreferenced.
+ *
+ * @note Both queues are bounded, so a caller decoding both streams has to
+ *       keep reading both of them, otherwise the demuxer blocks on the full
+ *       queue of the stream that is not read. Blocking on one stream is only
+ *       safe when the other is not decoded, players should poll both with
+ *       easy_av_session_try_read() instead.
+ *
+ * @return 0 on success, AVERROR_EOF at the end of the stream, or a negative
+ *         AVERROR code if the pipeline failed or the stream is not decoded.
+ */
+static inline int easy_av_session_read(EasyAVSession *session, enum AVMediaType type, AVFrame *frame)
+{
+    return easy_session_read_frame(session, type, frame, 1);
+}
+
+/**
+ * Get the next decoded frame of a stream if one is ready, without blocking.
+ *
+ * @return 0 on success, AVERROR(EAGAIN) if the decoder has not produced the
+ *         next frame yet, otherwise the same codes as easy_av_session_read().
+ */
+static inline int easy_av_session_try_read(EasyAVSession *session, enum AVMediaType type, AVFrame *frame)
+{
+    return easy_session_read_frame(session, type, frame, 0);
+}
+
+#endif // __EASY_SESSION_H__
@@ -0,0 +1,408 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_STATS_H__
+#define __EASY_STATS_H__
+
+#include "easy_common.h"
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/common.h>
+#include <libavutil/frame.h>
+#include <libavutil/time.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Log-linear buckets in the spirit of HdrHistogram: every power of two is
+ * split into 64 linear sub-buckets, so any recorded value is reported with
+ * less than 1.6% relative error while the whole range fits in 2K counters.
+ */
+#define EASY_HIST_SUB_BITS 7
+#define EASY_HIST_MAX_BITS 36 // values up to 2^36 us, about 19 hours
+#define EASY_HIST_BUCKETS  ((EASY_HIST_MAX_BITS - EASY_HIST_SUB_BITS + 2) << (EASY_HIST_SUB_BITS - 1))
+
+/* packets whose frame has not been consumed yet, older entries get evicted */
+#define EASY_STATS_PENDING 64
+
+/**
+ * A latency histogram with a fixed relative precision, values in microseconds.
+ */
+typedef struct EasyHistogram {
+    uint64_t counts[EASY_HIST_BUCKETS];
+    uint64_t count;
+    int64_t  min, max;
+    double   sum;
+} EasyHistogram;
+
+/**
+ * Reset a histogram to empty.
+ */
+static inline void easy_hist_reset(EasyHistogram *h)
+{
+    memset(h, 0, sizeof(*h));
+}
+
+static inline int easy_hist_index(int64_t value)
+{
+    uint64_t v = (uint64_t)value;
+    int msb, shift;
+
+    if (v >= (1ULL << EASY_HIST_MAX_BITS))
+        v = (1ULL << EASY_HIST_MAX_BITS) - 1;
+    msb   = v >> 32 ? 32 + av_log2((unsigned)(v >> 32)) : av_log2((unsigned)v);
+    shift = FFMAX(0, msb - (EASY_HIST_SUB_BITS - 1));
+    return (shift << (EASY_HIST_SUB_BITS - 1)) + (int)(v >> shift);
+}
+
+/* the highest value that lands in the same bucket as index */
+static inline int64_t easy_hist_bucket_value(int index)
+{
+    int half  = 1 << (EASY_HIST_SUB_BITS - 1);
+    int shift = index < 2 * half ? 0 : (index >> (EASY_HIST_SUB_BITS - 1)) - 1;
+    int64_t sub = index - ((int64_t)shift << (EASY_HIST_SUB_BITS - 1));
+
+    return ((sub + 1) << shift) - 1;
+}
+
+/**
+ * Add a value to a histogram. Negative values are recorded as 0.
+ */
+static inline void easy_hist_record(EasyHistogram *h, int64_t value)
+{
+    if (value < 0)
+        value = 0;
+    h->counts[easy_hist_index(value)]++;
+    if (!h->count || value < h->min)
+        h->min = value;
+    if (!h->count || value > h->max)
+        h->max = value;
+    h->count++;
+    h->sum += value;
+}
+
+/**
+ * Add every value recorded in src to dst, e.g. to combine per-worker histograms.
+ */
+static inline void easy_hist_merge(EasyHistogram *dst, const EasyHistogram *src)
+{
+    if (!src->count)
+        return;
+    for (int i = 0; i < EASY_HIST_BUCKETS; i++)
+        dst->counts[i] += src->counts[i];
+    if (!dst->count || src->min < dst->min)
+        dst->min = src->min;
+    if (!dst->count || src->max > dst->max)
+        dst->max = src->max;
+    dst->count += src->count;
+    dst->sum   += src->sum;
+}
+
+/**
+ * Get the value at a quantile of a histogram.
+ *
+ * @param h The histogram.
+ * @param q The quantile, e.g. 0.5, 0.99 or 0.999.
+ *
+ * @return The smallest recorded value such that a fraction q of the values
+ *         is below or equal to it, up to the bucket precision. 0 when empty.
+ */
+static inline int64_t easy_hist_quantile(const EasyHistogram *h, double q)
+{
+    uint64_t rank, seen = 0;
+
+    if (!h->count)
+        return 0;
+    rank = (uint64_t)(q * h->count + 0.5);
+    rank = FFMAX(rank, 1);
+    for (int i = 0; i < EASY_HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank)
+            return FFMIN(easy_hist_bucket_value(i), h->max);
+    }
+    return h->max;
+}
+
+/**
+ * Get the mean of the values recorded in a histogram.
+ */
+static inline double easy_hist_mean(const EasyHistogram *h)
+{
+    return h->count ? h->sum / h->count : 0;
+}
+
+/**
+ * The stages a frame goes through, each one gets a latency histogram.
+ */
+enum EasyStatsStage {
+    EASY_STAGE_DECODE,  ///< packet read -> frame available
+    EASY_STAGE_CONSUME, ///< frame available -> consumer done
+    EASY_STAGE_TOTAL,   ///< packet read -> consumer done
+    EASY_STAGE_NB
+};
+
+typedef struct EasyStatsPending {
+    int64_t pts;
+    int64_t read_time;
+    int64_t decoded_time; ///< 0 until the frame is available
+    int     used;
+} EasyStatsPending;
+
+/**
+ * Per-frame latency and throughput of one processing run.
+ *
+ * Packets and frames are matched by pts, which decoders pass through even
+ * when they reorder frames. Frames without a pts are counted but not timed.
+ *
+ * @note Not thread-safe, give each worker its own EasyRunStats and combine
+ *       their histograms with easy_hist_merge().
+ */
+typedef struct EasyRunStats {
+    const char      *name;      ///< label of the run in the reports
+    EasyHistogram    latency[EASY_STAGE_NB];
+    EasyStatsPending pending[EASY_STATS_PENDING];
+    int              next_slot;
+
+    int64_t          start_time;
+    int64_t          end_time;  ///< 0 while the run is in progress
+    int64_t          packets;
+    int64_t          bytes;
+    int64_t          frames;    ///< frames the consumer is done with
+    int64_t          untimed;   ///< frames that could not be matched to a packet
+    int64_t          evicted;   ///< packets dropped from the pending table
+} EasyRunStats;
+
+static inline const char *easy_stats_stage_name(enum EasyStatsStage stage)
+{
+    static const char *const names[EASY_STAGE_NB] = { "decode", "consume", "total" };
+    return names[stage];
+}
+
+/**
+ * Start a run.
+ *
+ * @param stats The stats to initialize.
+ * @param name The label of the run, kept by reference.
+ */
+static inline void easy_run_stats_init(EasyRunStats *stats, const char *name)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->name       = name;
+    stats->start_time = av_gettime_relative();
+}
+
+static inline EasyStatsPending *easy_run_stats_find(EasyRunStats *stats, int64_t pts)
+{
+    if (pts == AV_NOPTS_VALUE)
+        return NULL;
+    for (int i = 0; i < EASY_STATS_PENDING; i++)
+        if (stats->pending[i].used && stats->pending[i].pts == pts)
+            return &stats->pending[i];
+    return NULL;
+}
+
+/**
+ * Account a packet that was just read, starting the clock of its frame.
+ */
+static inline void easy_run_stats_packet_read(EasyRunStats *stats, const AVPacket *pkt)
+{
+    EasyStatsPending *slot;
+
+    stats->packets++;
+    stats->bytes += pkt->size;
+    if (pkt->pts == AV_NOPTS_VALUE)
+        return;
+
+    slot = &stats->pending[stats->next_slot];
+    stats->next_slot = (stats->next_slot + 1) % EASY_STATS_PENDING;
+    if (slot->used)
+        stats->evicted++;
+    slot->pts          = pkt->pts;
+    slot->read_time    = av_gettime_relative();
+    slot->decoded_time = 0;
+    slot->used         = 1;
+}
+
+/**
+ * Account input bytes that are not timed, e.g. packets of secondary inputs.
+ */
+static inline void easy_run_stats_add_bytes(EasyRunStats *stats, int64_t bytes)
+{
+    stats->packets++;
+    stats->bytes += bytes;
+}
+
+/**
+ * Mark the frame as available from the decoder (or filter graph).
+ */
+static inline void easy_run_stats_frame_decoded(EasyRunStats *stats, const AVFrame *frame)
+{
+    EasyStatsPending *slot = easy_run_stats_find(stats, frame->pts);
+
+    if (!slot || slot->decoded_time)
+        return;
+    slot->decoded_time = av_gettime_relative();
+    easy_hist_record(&stats->latency[EASY_STAGE_DECODE], slot->decoded_time - slot->read_time);
+}
+
+/**
+ * Mark the consumer as done with the frame, e.g. after saving or rendering it.
+ */
+static inline void easy_run_stats_frame_done(EasyRunStats *stats, const AVFrame *frame)
+{
+    EasyStatsPending *slot = easy_run_stats_find(stats, frame->pts);
+    int64_t now = av_gettime_relative();
+
+    stats->frames++;
+    if (!slot) {
+        stats->untimed++;
+        return;
+    }
+    if (slot->decoded_time)
+        easy_hist_record(&stats->latency[EASY_STAGE_CONSUME], now - slot->decoded_time);
+    easy_hist_record(&stats->latency[EASY_STAGE_TOTAL], now - slot->read_time);
+    slot->used = 0;
+}
+
+/**
+ * Stop the clock of a run, the reports then use a fixed duration.
+ */
+static inline void easy_run_stats_finish(EasyRunStats *stats)
+{
+    stats->end_time = av_gettime_relative();
+}
+
+/**
+ * Get the wall-clock duration of a run in seconds.
+ */
+static inline double easy_run_stats_duration(const EasyRunStats *stats)
+{
+    int64_t end = stats->end_time ? stats->end_time : av_gettime_relative();
+    return (end - stats->start_time) / 1000000.0;
+}
+
+/*
+ * Escape the run name for a JSON string or a Prometheus label value, which
+ * both take \\, \" and \n; other control characters are dropped. The result
+ * is freed with av_free().
+ */
+static inline char *easy_run_stats_escape_name(const EasyRunStats *stats)
+{
+    const char *s = stats->name ? stats->name : "";
+    char *escaped = (char *)av_malloc(2 * strlen(s) + 1), *p = escaped;
+
+    if (!escaped)
+        return NULL;
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            *p++ = '\\';
+            *p++ = *s;
+        } else if (*s == '\n') {
+            *p++ = '\\';
+            *p++ = 'n';
+        } else if ((unsigned char)*s >= 0x20) {
+            *p++ = *s;
+        }
+    }
+    *p = 0;
+    return escaped;
+}
+
+/**
+ * Write a run summary as a JSON object.
+ *
+ * Latencies are in microseconds, e.g.
+ * {"name":"decode","duration":2.5,"frames":250,"fps":100.0,...,
+ *  "latency":{"decode":{"count":250,"mean":812.4,"min":301,"p50":790,...}}}
+ *
+ * @return 0 on success, AVERROR(EIO) if writing failed.
+ */
+static inline int easy_run_stats_write_json(const EasyRunStats *stats, FILE *f)
+{
+    double duration = easy_run_stats_duration(stats);
+    char *name = easy_run_stats_escape_name(stats);
+
+    if (!name)
+        return AVERROR(ENOMEM);
+    fprintf(f, "{\"name\":\"%s\",\"duration\":%.6f,\"frames\":%lld,\"packets\":%lld,\"bytes\":%lld,"
+               "\"fps\":%.3f,\"bytes_per_second\":%.1f,\"untimed\":%lld,\"evicted\":%lld,\"latency\":{",
+            name, duration,
+            (long long)stats->frames, (long long)stats->packets, (long long)stats->bytes,
+            duration > 0 ? stats->frames / duration : 0, duration > 0 ? stats->bytes / duration : 0,
+            (long long)stats->untimed, (long long)stats->evicted);
+    for (int i = 0; i < EASY_STAGE_NB; i++) {
+        const EasyHistogram *h = &stats->latency[i];
+        fprintf(f, "%s\"%s\":{\"count\":%llu,\"mean\":%.1f,\"min\":%lld,\"p50\":%lld,\"p99\":%lld,"
+                   "\"p999\":%lld,\"max\":%lld}",
+                i ? "," : "", easy_stats_stage_name((enum EasyStatsStage)i),
+                (unsigned long long)h->count, easy_hist_mean(h), (long long)h->min,
+                (long long)easy_hist_quantile(h, 0.5), (long long)easy_hist_quantile(h, 0.99),
+                (long long)easy_hist_quantile(h, 0.999), (long long)h->max);
+    }
+    fprintf(f, "}}\n");
+    av_free(name);
+
+    return ferror(f) ? AVERROR(EIO) : 0;
+}
+
+/**
+ * Write a run summary in the Prometheus text exposition format, latencies
+ * as a summary in seconds labeled by stage.
+ *
+ * @return 0 on success, AVERROR(EIO) if writing failed.
+ */
+static inline int easy_run_stats_write_prometheus(const EasyRunStats *stats, FILE *f)
+{
+    static const double quantiles[] = { 0.5, 0.99, 0.999 };
+    char *name = easy_run_stats_escape_name(stats);
+    double duration = easy_run_stats_duration(stats);
+
+    if (!name)
+        return AVERROR(ENOMEM);
+
+    fprintf(f, "# HELP easyffmpeg_frame_latency_seconds Per-frame latency by pipeline stage.\n"
+               "# TYPE easyffmpeg_frame_latency_seconds summary\n");
+    for (int i = 0; i < EASY_STAGE_NB; i++) {
+        const EasyHistogram *h = &stats->latency[i];
+        const char *stage = easy_stats_stage_name((enum EasyStatsStage)i);
+
+        for (size_t q = 0; q < FF_ARRAY_ELEMS(quantiles); q++)
+            fprintf(f, "easyffmpeg_frame_latency_seconds{run=\"%s\",stage=\"%s\",quantile=\"%g\"} %.6f\n",
+                    name, stage, quantiles[q], easy_hist_quantile(h, quantiles[q]) / 1000000.0);
+        fprintf(f, "easyffmpeg_frame_latency_seconds_sum{run=\"%s\",stage=\"%s\"} %.6f\n",
+                name, stage, h->sum / 1000000.0);
+        fprintf(f, "easyffmpeg_frame_latency_seconds_count{run=\"%s\",stage=\"%s\"} %llu\n",
+                name, stage, (unsigned long long)h->count);
+    }
+
+    fprintf(f, "# TYPE easyffmpeg_frames_total counter\n"
+               "easyffmpeg_frames_total{run=\"%s\"} %lld\n", name, (long long)stats->frames);
+    fprintf(f, "# TYPE easyffmpeg_packets_total counter\n"
+               "easyffmpeg_packets_total{run=\"%s\"} %lld\n", name, (long long)stats->packets);
+    fprintf(f, "# TYPE easyffmpeg_bytes_total counter\n"
+               "easyffmpeg_bytes_total{run=\"%s\"} %lld\n", name, (long long)stats->bytes);
+    fprintf(f, "# TYPE easyffmpeg_frames_per_second gauge\n"
+               "easyffmpeg_frames_per_second{run=\"%s\"} %.3f\n",
+            name, duration > 0 ? stats->frames / duration : 0);
+    fprintf(f, "# TYPE easyffmpeg_bytes_per_second gauge\n"
+               "easyffmpeg_bytes_per_second{run=\"%s\"} %.1f\n",
+            name, duration > 0 ? stats->bytes / duration : 0);
+    av_free(name);
+
+    return ferror(f) ? AVERROR(EIO) : 0;
+}
+
+#endif // __EASY_STATS_H__
@@ -0,0 +1,386 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_THREAD_H__
+#define __EASY_THREAD_H__
+
+#include "easy_common.h"
+#include "easy_trace.h"
+
+#include <libavutil/avutil.h>
+#include <libavutil/cpu.h>
+#include <libavutil/mem.h>
+
+#include <pthread.h>
+#include <string.h>
+
+/**
+ * A bounded blocking FIFO of pointers, used to hand packets and frames
+ * between pipeline threads.
+ */
+typedef struct EasyFifo {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    void          **items;
+    int             capacity;
+    int             head;
+    int             count;
+    int             finished; ///< the producer will not push anymore
+    int             aborted;  ///< the pipeline is being torn down
+} EasyFifo;
+
+/**
+ * Initialize a FIFO.
+ *
+ * @param fifo The FIFO to initialize.
+ * @param capacity The number of items it holds before push blocks.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_fifo_init(EasyFifo *fifo, int capacity)
+{
+    fifo->items = (void **)av_calloc(capacity, sizeof(*fifo->items));
+    if (!fifo->items)
+        return AVERROR(ENOMEM);
+    if (pthread_mutex_init(&fifo->lock, NULL)) {
+        av_freep(&fifo->items);
+        return AVERROR(ENOMEM);
+    }
+    if (pthread_cond_init(&fifo->cond, NULL)) {
+        pthread_mutex_destroy(&fifo->lock);
+        av_freep(&fifo->items);
+        return AVERROR(ENOMEM);
+    }
+    fifo->capacity = capacity;
+    fifo->head     = 0;
+    fifo->count    = 0;
+    fifo->finished = 0;
+    fifo->aborted  = 0;
+    return 0;
+}
+
+/**
+ * Release a FIFO, passing every item still queued to free_item.
+ *
+ * @param fifo The FIFO to release, no thread may use it anymore.
+ * @param free_item Called with a pointer to each remaining item, may be NULL.
+ */
+static inline void easy_fifo_uninit(EasyFifo *fifo, void (*free_item)(void *item_ptr))
+{
+    if (!fifo->items)
+        return;
+    for (int i = 0; i < fifo->count; i++) {
+        void *item = fifo->items[(fifo->head + i) % fifo->capacity];
+        if (free_item)
+            free_item(&item);
+    }
+    pthread_cond_destroy(&fifo->cond);
+    pthread_mutex_destroy(&fifo->lock);
+    av_freep(&fifo->items);
+}
+
+/**
+ * Append an item, blocking while the FIFO is full.
+ *
+ * @return 0 on success, AVERROR_EXIT if the FIFO was aborted.
+ */
+static inline int easy_fifo_push(EasyFifo *fifo, void *item)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&fifo->lock);
+    if (!fifo->aborted && fifo->count == fifo->capacity) {
+        /* shows up on the trace timeline as the producer stalling on a full queue */
+        int64_t trace = easy_trace_begin();
+        while (!fifo->aborted && fifo->count == fifo->capacity)
+            pthread_cond_wait(&fifo->cond, &fifo->lock);
+        easy_trace_end(trace, "fifo full wait");
+    }
+    if (fifo->aborted) {
+        ret = AVERROR_EXIT;
+    } else {
+        fifo->items[(fifo->head + fifo->count) % fifo->capacity] = item;
+        fifo->count++;
+        pthread_cond_broadcast(&fifo->cond);
+    }
+    pthread_mutex_unlock(&fifo->lock);
+
+    return ret;
+}
+
+/**
+ * Remove the oldest item, blocking while the FIFO is empty.
+ *
+ * @return 0 on success, AVERROR_EOF once the producer finished and the FIFO
+ *         is drained, AVERROR_EXIT if the FIFO was aborted.
+ */
+static inline int easy_fifo_pop(EasyFifo *fifo, void **item)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&fifo->lock);
+    if (!fifo->aborted && !fifo->finished && !fifo->count) {
+        int64_t trace = easy_trace_begin();
+        while (!fifo->aborted && !fifo->finished && !fifo->count)
+            pthread_cond_wait(&fifo->cond, &fifo->lock);
+        easy_trace_end(trace, "fifo empty wait");
+    }
+    if (fifo->aborted) {
+        ret = AVERROR_EXIT;
+    } else if (!fifo->count) {
+        ret = AVERROR_EOF;
+    } else {
+        *item = fifo->items[fifo->head];
+        fifo->head = (fifo->head + 1) % fifo->capacity;
+        fifo->count--;
+        pthread_cond_broadcast(&fifo->cond);
+    }
+    pthread_mutex_unlock(&fifo->lock);
+
+    return ret;
+}
+
+/**
+ * Remove the oldest item without blocking.
+ *
+ * @return 0 on success, AVERROR(EAGAIN) if the FIFO is empty but the producer
+ *         is still running, otherwise the same codes as easy_fifo_pop().
+ */
+static inline int easy_fifo_try_pop(EasyFifo *fifo, void **item)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&fifo->lock);
+    if (fifo->aborted) {
+        ret = AVERROR_EXIT;
+    } else if (!fifo->count) {
+        ret = fifo->finished ? AVERROR_EOF : AVERROR(EAGAIN);
+    } else {
+        *item = fifo->items[fifo->head];
+        fifo->head = (fifo->head + 1) % fifo->capacity;
+        fifo->count--;
+        pthread_cond_broadcast(&fifo->cond);
+    }
+    pthread_mutex_unlock(&fifo->lock);
+
+    return ret;
+}
+
+/**
+ * Drop every queued item, e.g. to release the memory they hold while
+ * tearing a pipeline down.
+ *
+ * @param fifo The FIFO to empty.
+ * @param free_item Called with a pointer to each dropped item, may be NULL.
+ */
+static inline void easy_fifo_flush(EasyFifo *fifo, void (*free_item)(void *item_ptr))
+{
+    pthread_mutex_lock(&fifo->lock);
+    for (; fifo->count; fifo->count--) {
+        void *item = fifo->items[fifo->head];
+        fifo->head = (fifo->head + 1) % fifo->capacity;
+        if (free_item)
+            free_item(&item);
+    }
+    pthread_cond_broadcast(&fifo->cond);
+    pthread_mutex_unlock(&fifo->lock);
+}
+
+/**
+ * Signal that no more items will be pushed, consumers get AVERROR_EOF once
+ * the FIFO is drained.
+ */
+static inline void easy_fifo_finish(EasyFifo *fifo)
+{
+    pthread_mutex_lock(&fifo->lock);
+    fifo->finished = 1;
+    pthread_cond_broadcast(&fifo->cond);
+    pthread_mutex_unlock(&fifo->lock);
+}
+
+/**
+ * Wake up every blocked producer and consumer and make them fail with
+ * AVERROR_EXIT.
+ */
+static inline void easy_fifo_abort(EasyFifo *fifo)
+{
+    pthread_mutex_lock(&fifo->lock);
+    fifo->aborted = 1;
+    pthread_cond_broadcast(&fifo->cond);
+    pthread_mutex_unlock(&fifo->lock);
+}
+
+/**
+ * A fixed set of threads running the jobs of one easy_worker_pool_execute()
+ * call at a time. The calling thread runs jobs too.
+ */
+typedef int (*EasyWorkerFunc)(void *opaque, int job, int worker);
+
+typedef struct EasyWorkerPool {
+    pthread_mutex_t lock;
+    pthread_cond_t  work_cond;   ///< workers wait here for a new batch
+    pthread_cond_t  done_cond;   ///< execute waits here for the batch to finish
+    pthread_t      *threads;
+    int             nb_threads;  ///< threads including the caller
+    int             nb_started;
+    EasyWorkerFunc  func;
+    void           *opaque;
+    int             nb_jobs;
+    int             next_job;
+    int             running;     ///< jobs taken but not finished
+    unsigned        generation;  ///< bumped for every batch
+    int             ret;         ///< first error of the batch
+    int             quit;
+} EasyWorkerPool;
+
+typedef struct EasyWorkerArg {
+    EasyWorkerPool *pool;
+    int             worker;
+} EasyWorkerArg;
+
+/* run jobs of the current batch until none is left, called with the lock held */
+static inline void easy_worker_pool_run(EasyWorkerPool *pool, int worker)
+{
+    while (pool->next_job < pool->nb_jobs) {
+        int job = pool->next_job++;
+        int ret;
+
+        pool->running++;
+        pthread_mutex_unlock(&pool->lock);
+        ret = pool->func(pool->opaque, job, worker);
+        pthread_mutex_lock(&pool->lock);
+        pool->running--;
+        if (ret < 0 && pool->ret >= 0) {
+            pool->ret = ret;
+            pool->next_job = pool->nb_jobs; // no point starting the others
+        }
+    }
+    if (!pool->running)
+        pthread_cond_broadcast(&pool->done_cond);
+}
+
+static inline void *easy_worker_pool_thread(void *arg)
+{
+    EasyWorkerPool *pool = ((EasyWorkerArg *)arg)->pool;
+    int worker = ((EasyWorkerArg *)arg)->worker;
+    unsigned seen = 0;
+
+    av_free(arg);
+    easy_trace_thread_name("worker");
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->quit && pool->generation == seen)
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        if (pool->quit)
+            break;
+        seen = pool->generation;
+        easy_worker_pool_run(pool, worker);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * Release a worker pool, joining its threads.
+ */
+static inline void easy_worker_pool_uninit(EasyWorkerPool *pool)
+{
+    if (!pool->threads)
+        return;
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->nb_started; i++)
+        pthread_join(pool->threads[i], NULL);
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->lock);
+    av_freep(&pool->threads);
+}
+
+/**
+ * Start a worker pool.
+ *
+ * @param pool The pool to initialize.
+ * @param nb_threads The number of threads running jobs including the caller
+ *                   of easy_worker_pool_execute(), <= 0 for one per CPU.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_worker_pool_init(EasyWorkerPool *pool, int nb_threads)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->nb_threads = nb_threads > 0 ? nb_threads : av_cpu_count();
+
+    /* one slot even for a single thread, threads != NULL marks the pool as initialized */
+    pool->threads = (pthread_t *)av_calloc(pool->nb_threads, sizeof(*pool->threads));
+    if (!pool->threads)
+        return AVERROR(ENOMEM);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    for (int i = 1; i < pool->nb_threads; i++) {
+        EasyWorkerArg *arg = (EasyWorkerArg *)av_malloc(sizeof(*arg));
+        if (!arg) {
+            easy_worker_pool_uninit(pool);
+            return AVERROR(ENOMEM);
+        }
+        arg->pool   = pool;
+        arg->worker = i;
+        if (pthread_create(&pool->threads[pool->nb_started], NULL, easy_worker_pool_thread, arg)) {
+            av_free(arg);
+            easy_worker_pool_uninit(pool);
+            return AVERROR(EAGAIN);
+        }
+        pool->nb_started++;
+    }
+    return 0;
+}
+
+/**
+ * Run func for every job in [0, nb_jobs) on the pool and wait for all of them.
+ *
+ * Jobs are handed out in order to whichever thread is free, so uneven jobs
+ * balance themselves. worker is in [0, nb_threads) and unique among the jobs
+ * running at the same time, to index per-thread state.
+ *
+ * @return 0 on success, the first negative value returned by func otherwise.
+ *         Jobs not started yet when a job fails are skipped.
+ */
+static inline int easy_worker_pool_execute(EasyWorkerPool *pool, EasyWorkerFunc func, void *opaque, int nb_jobs)
+{
+    int ret;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->func     = func;
+    pool->opaque   = opaque;
+    pool->nb_jobs  = nb_jobs;
+    pool->next_job = 0;
+    pool->running  = 0;
+    pool->ret      = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cond);
+
+    easy_worker_pool_run(pool, 0);
+    while (pool->running || pool->next_job < pool->nb_jobs)
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    ret = pool->ret;
+    pthread_mutex_unlock(&pool->lock);
+
+    return ret;
+}
+
+#endif // __EASY_THREAD_H__
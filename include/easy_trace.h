@@ -0,0 +1,431 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_TRACE_H__
+#define __EASY_TRACE_H__
+
+#include "easy_common.h"
+
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/avstring.h>
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Spans are recorded into per-thread chunks without taking a lock; the
+ * tracer mutex is only taken when a thread registers or fills a chunk.
+ * easy_trace_stop() writes every chunk as Chrome trace-event JSON, which
+ * chrome://tracing and https://ui.perfetto.dev open as a timeline.
+ *
+ * The headers need nothing else: with GCC and Clang every translation unit
+ * carries a weak copy of the tracer state and the linker keeps one per
+ * binary, other compilers fall back to one tracer per translation unit.
+ * Define EASY_TRACE_SHARED to use the copy exported by libeasyffmpeg
+ * instead, e.g. to share one trace between DLLs.
+ *
+ * Define EASY_DISABLE_TRACE to compile every span out.
+ */
+#define EASY_TRACE_CHUNK_EVENTS 4096
+#define EASY_TRACE_MAX_CHUNKS   1024 // about 4M events, further events are dropped
+#define EASY_TRACE_MAX_THREADS  64
+
+#if defined(__cplusplus)
+#define EASY_THREAD_LOCAL thread_local
+#elif defined(_MSC_VER)
+#define EASY_THREAD_LOCAL __declspec(thread)
+#else
+#define EASY_THREAD_LOCAL _Thread_local
+#endif
+
+/* enabled and generation are read without the lock by every traced call */
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define EASY_ATOMIC_LOAD(p)     _InterlockedOr((volatile long *)(p), 0)
+#define EASY_ATOMIC_STORE(p, v) _InterlockedExchange((volatile long *)(p), (v))
+#else
+#define EASY_ATOMIC_LOAD(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define EASY_ATOMIC_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
+typedef struct EasyTraceEvent {
+    const char *name;  ///< static string, not escaped in the output
+    int64_t     ts;    ///< start, ns since the tracer started
+    int64_t     value; ///< duration in ns for spans, the value for counters
+    char        ph;    ///< 'X' complete span, 'C' counter
+} EasyTraceEvent;
+
+typedef struct EasyTraceChunk {
+    struct EasyTraceChunk *next;
+    int                    tid;
+    int                    count;
+    EasyTraceEvent         events[EASY_TRACE_CHUNK_EVENTS];
+} EasyTraceChunk;
+
+typedef struct EasyTraceThread {
+    int         tid;
+    const char *name;
+} EasyTraceThread;
+
+/**
+ * The process-wide tracer state, see easy_tracer().
+ */
+typedef struct EasyTracer {
+    pthread_mutex_t  lock;
+    int              enabled;     ///< atomic, written with the lock held
+    int              generation;  ///< atomic, bumped by every start and stop, invalidates thread chunks
+    int              next_tid;
+    int              nb_chunks;
+    int64_t          dropped;
+    int64_t          epoch;
+    EasyTraceChunk  *chunks;      ///< every chunk of the current trace
+    EasyTraceThread  threads[EASY_TRACE_MAX_THREADS]; ///< names given with easy_trace_thread_name()
+    int              nb_threads;
+    char             filename[1024];
+} EasyTracer;
+
+/**
+ * The state of the calling thread, see easy_trace_local().
+ */
+typedef struct EasyTraceLocal {
+    EasyTraceChunk *chunk;      ///< the chunk the thread appends to
+    int             generation; ///< the tracer generation chunk and tid belong to
+    int             tid;
+} EasyTraceLocal;
+
+#if defined(EASY_DISABLE_TRACE)
+/* nothing is ever recorded, every translation unit may keep its own idle state */
+#define EASY_TRACE_STATE static inline
+#elif defined(EASY_TRACE_IMPLEMENTATION)
+/* the exported copy of libeasyffmpeg, see src/easy_trace.c */
+#define EASY_TRACE_STATE EASY_API
+#elif !defined(EASY_TRACE_SHARED) && (defined(__GNUC__) || defined(__clang__))
+/* one copy per translation unit, merged into one per binary by the linker */
+#define EASY_TRACE_STATE __attribute__((weak))
+#elif !defined(EASY_TRACE_SHARED)
+#define EASY_TRACE_STATE static inline
+#endif
+
+#ifndef EASY_TRACE_STATE
+/**
+ * Get the tracer of the process, exported by libeasyffmpeg.
+ */
+EASY_API EasyTracer *easy_tracer(void);
+
+/**
+ * Get the tracer state of the calling thread, exported by libeasyffmpeg.
+ */
+EASY_API EasyTraceLocal *easy_trace_local(void);
+#else
+/**
+ * Get the tracer of the process.
+ */
+EASY_TRACE_STATE EasyTracer *easy_tracer(void)
+{
+    static EasyTracer tracer = { PTHREAD_MUTEX_INITIALIZER, 0, 0, 0, 0, 0, 0, NULL, { { 0, NULL } }, 0, { 0 } };
+    return &tracer;
+}
+
+/**
+ * Get the tracer state of the calling thread.
+ */
+EASY_TRACE_STATE EasyTraceLocal *easy_trace_local(void)
+{
+    static EASY_THREAD_LOCAL EasyTraceLocal local = { NULL, -1, 0 };
+    return &local;
+}
+#endif
+
+static inline int64_t easy_trace_clock(void)
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    return av_gettime_relative() * 1000;
+#endif
+}
+
+/* the chunk the calling thread appends to, NULL if the trace is full */
+static inline EasyTraceChunk *easy_trace_thread_chunk(EasyTracer *tracer, int need_new)
+{
+    EasyTraceLocal *local = easy_trace_local();
+    EasyTraceChunk *next;
+
+    if (local->generation == EASY_ATOMIC_LOAD(&tracer->generation) && local->chunk && !need_new)
+        return local->chunk;
+
+    pthread_mutex_lock(&tracer->lock);
+    if (local->generation != tracer->generation) {
+        local->generation = tracer->generation;
+        local->tid        = ++tracer->next_tid;
+    }
+    next = NULL;
+    if (tracer->nb_chunks < EASY_TRACE_MAX_CHUNKS)
+        next = (EasyTraceChunk *)av_malloc(sizeof(*next));
+    if (next) {
+        next->tid   = local->tid;
+        next->count = 0;
+        next->next  = tracer->chunks;
+        tracer->chunks = next;
+        tracer->nb_chunks++;
+    }
+    pthread_mutex_unlock(&tracer->lock);
+
+    return local->chunk = next;
+}
+
+static inline int easy_trace_current_tid(void)
+{
+    EasyTracer *tracer = easy_tracer();
+    EasyTraceChunk *chunk = easy_trace_thread_chunk(tracer, 0);
+    return chunk ? chunk->tid : 0;
+}
+
+static inline void easy_trace_add(char ph, const char *name, int64_t ts, int64_t value)
+{
+    EasyTracer *tracer = easy_tracer();
+    EasyTraceChunk *chunk = easy_trace_thread_chunk(tracer, 0);
+    EasyTraceEvent *ev;
+
+    if (chunk && chunk->count == EASY_TRACE_CHUNK_EVENTS)
+        chunk = easy_trace_thread_chunk(tracer, 1);
+    if (!chunk) {
+        pthread_mutex_lock(&tracer->lock);
+        tracer->dropped++;
+        pthread_mutex_unlock(&tracer->lock);
+        return;
+    }
+    ev = &chunk->events[chunk->count++];
+    ev->name  = name;
+    ev->ts    = ts - tracer->epoch;
+    ev->value = value;
+    ev->ph    = ph;
+}
+
+/**
+ * Start recording spans from every thread.
+ *
+ * @param filename The trace-event JSON file written by easy_trace_stop().
+ *
+ * @return 0 on success, AVERROR(EBUSY) if a trace is already running.
+ */
+static inline int easy_trace_start(const char *filename)
+{
+    EasyTracer *tracer = easy_tracer();
+    int ret = 0;
+
+    pthread_mutex_lock(&tracer->lock);
+    if (tracer->enabled) {
+        ret = AVERROR(EBUSY);
+    } else {
+        av_strlcpy(tracer->filename, filename, sizeof(tracer->filename));
+        EASY_ATOMIC_STORE(&tracer->generation, tracer->generation + 1);
+        tracer->next_tid   = 0;
+        tracer->nb_threads = 0;
+        tracer->dropped    = 0;
+        tracer->epoch      = easy_trace_clock();
+        EASY_ATOMIC_STORE(&tracer->enabled, 1);
+    }
+    pthread_mutex_unlock(&tracer->lock);
+
+    return ret;
+}
+
+/**
+ * Check whether spans are being recorded.
+ */
+static inline int easy_trace_enabled(void)
+{
+#ifdef EASY_DISABLE_TRACE
+    return 0;
+#else
+    return EASY_ATOMIC_LOAD(&easy_tracer()->enabled);
+#endif
+}
+
+/**
+ * Name the calling thread in the trace, e.g. "demux" or "video decode".
+ *
+ * @param name A static string.
+ */
+static inline void easy_trace_thread_name(const char *name)
+{
+    EasyTracer *tracer = easy_tracer();
+    int tid;
+
+    if (!easy_trace_enabled() || !(tid = easy_trace_current_tid()))
+        return;
+    pthread_mutex_lock(&tracer->lock);
+    if (tracer->nb_threads < EASY_TRACE_MAX_THREADS) {
+        tracer->threads[tracer->nb_threads].tid  = tid;
+        tracer->threads[tracer->nb_threads].name = name;
+        tracer->nb_threads++;
+    }
+    pthread_mutex_unlock(&tracer->lock);
+}
+
+/**
+ * Open a span on the calling thread.
+ *
+ * @return The start time to pass to easy_trace_end(), 0 if tracing is off.
+ */
+static inline int64_t easy_trace_begin(void)
+{
+    return easy_trace_enabled() ? easy_trace_clock() : 0;
+}
+
+/**
+ * Close a span opened with easy_trace_begin().
+ *
+ * @param start The value easy_trace_begin() returned.
+ * @param name The span name, a static string.
+ */
+static inline void easy_trace_end(int64_t start, const char *name)
+{
+    if (start && easy_trace_enabled())
+        easy_trace_add('X', name, start, easy_trace_clock() - start);
+}
+
+/**
+ * Record the current value of a counter, e.g. a queue depth.
+ *
+ * @param name The counter name, a static string.
+ */
+static inline void easy_trace_counter(const char *name, int64_t value)
+{
+    if (easy_trace_enabled())
+        easy_trace_add('C', name, easy_trace_clock(), value);
+}
+
+/**
+ * Stop recording, write the trace file and free every recorded event.
+ *
+ * @note Other threads must not be inside a span while the trace stops, stop
+ *       it after the pipeline threads were joined.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_trace_stop(void)
+{
+    EasyTracer *tracer = easy_tracer();
+    EasyTraceChunk *chunk, *next;
+    const char *sep = "";
+    FILE *f;
+    int ret = 0;
+
+    pthread_mutex_lock(&tracer->lock);
+    if (!tracer->enabled) {
+        pthread_mutex_unlock(&tracer->lock);
+        return AVERROR(EINVAL);
+    }
+    EASY_ATOMIC_STORE(&tracer->enabled, 0);
+
+    f = fopen(tracer->filename, "w");
+    if (!f) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot open trace file %s\n", tracer->filename);
+        ret = AVERROR(errno);
+    } else {
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        for (int i = 0; i < tracer->nb_threads; i++, sep = ",\n")
+            fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    sep, tracer->threads[i].tid, tracer->threads[i].name);
+        for (chunk = tracer->chunks; chunk; chunk = chunk->next) {
+            for (int i = 0; i < chunk->count; i++, sep = ",\n") {
+                const EasyTraceEvent *ev = &chunk->events[i];
+                if (ev->ph == 'X')
+                    fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"easy\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                               "\"ts\":%.3f,\"dur\":%.3f}",
+                            sep, ev->name, chunk->tid, ev->ts / 1000.0, ev->value / 1000.0);
+                else
+                    fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                               "\"args\":{\"value\":%lld}}",
+                            sep, ev->name, chunk->tid, ev->ts / 1000.0, (long long)ev->value);
+            }
+        }
+        fprintf(f, "\n]}\n");
+        if (ferror(f))
+            ret = AVERROR(EIO);
+        fclose(f);
+    }
+    if (tracer->dropped)
+        av_log(NULL, AV_LOG_WARNING, "Trace full, %lld events dropped\n", (long long)tracer->dropped);
+
+    for (chunk = tracer->chunks; chunk; chunk = next) {
+        next = chunk->next;
+        av_free(chunk);
+    }
+    tracer->chunks    = NULL;
+    tracer->nb_chunks = 0;
+    /* threads still holding a chunk of this trace allocate a new one next time */
+    EASY_ATOMIC_STORE(&tracer->generation, tracer->generation + 1);
+    pthread_mutex_unlock(&tracer->lock);
+
+    return ret;
+}
+
+/**
+ * Run a statement inside a span, e.g.
+ * EASY_TRACE_CALL("filter push", ret = av_buffersrc_add_frame(src, frame));
+ */
+#ifdef EASY_DISABLE_TRACE
+#define EASY_TRACE_CALL(name, stmt) do { stmt; } while (0)
+#else
+#define EASY_TRACE_CALL(name, stmt)                 \
+    do {                                            \
+        int64_t easy_trace_start_ = easy_trace_begin(); \
+        stmt;                                       \
+        easy_trace_end(easy_trace_start_, name);    \
+    } while (0)
+#endif
+
+/**
+ * av_read_frame() recorded as a "read_frame" span.
+ */
+static inline int easy_read_frame(AVFormatContext *fmt_ctx, AVPacket *pkt)
+{
+    int ret;
+    EASY_TRACE_CALL("read_frame", ret = av_read_frame(fmt_ctx, pkt));
+    return ret;
+}
+
+/**
+ * avcodec_send_packet() recorded as a "send_packet" span.
+ */
+static inline int easy_send_packet(AVCodecContext *avctx, const AVPacket *pkt)
+{
+    int ret;
+    EASY_TRACE_CALL("send_packet", ret = avcodec_send_packet(avctx, pkt));
+    return ret;
+}
+
+/**
+ * avcodec_receive_frame() recorded as a "receive_frame" span.
+ */
+static inline int easy_receive_frame(AVCodecContext *avctx, AVFrame *frame)
+{
+    int ret;
+    EASY_TRACE_CALL("receive_frame", ret = avcodec_receive_frame(avctx, frame));
+    return ret;
+}
+
+#endif // __EASY_TRACE_H__
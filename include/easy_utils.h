@@ -16,12 +16,17 @@
 #define __EASY_UTILS_H__
 
 #include "easy_common.h"
+#include "easy_color.h"
+#include "easy_trace.h"
 
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
 #include <libswscale/swscale.h>
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 
 /**
@@ -59,6 +64,7 @@ static inline int easy_save_pgm(unsigned char* buffer, int linesize, int width,
  * @return 0 on success, -1 on failure.
  */
 static inline int easy_save_ppm(unsigned char* buffer, int linesize, int width, int height, char *name) {
+    int64_t trace = easy_trace_begin();
     FILE *f = fopen(name, "wb");
     if (!f) return -1;
     
@@ -68,6 +74,7 @@ static inline int easy_save_ppm(unsigned char* buffer, int linesize, int width,
     }
 
     fclose(f);
+    easy_trace_end(trace, "save");
     return 0;
 }
 
@@ -85,7 +92,11 @@ static inline int easy_save_ppm(unsigned char* buffer, int linesize, int width,
  * 
  * @return 0 on success, -1 on failure.
  */
-int easy_save_yuv_to_ppm(unsigned char* y, unsigned char* u, unsigned char* v, int width, int height, const char* filename) {
+static inline int easy_save_yuv_to_ppm(unsigned char* y, unsigned char* u, unsigned char* v, int width, int height, const char* filename) {
+    static EASY_THREAD_LOCAL EasyYuvToRgb tables; // built on the first call of each thread
+    const uint8_t *data[3] = { y, u, v };
+    const int linesize[3] = { width, width / 2, width / 2 };
+
     FILE *f = fopen(filename, "wb");
     if (!f) return -1;  // Error opening file
 
@@ -99,32 +110,10 @@ int easy_save_yuv_to_ppm(unsigned char* y, unsigned char* u, unsigned char* v, i
         return -1;  // Memory allocation failure
     }
 
-    int buffer_index = 0;  // To track position in the buffer
-
-    // Convert YUV to RGB and store in the buffer
-    for (int j = 0; j < height; j++) {
-        for (int i = 0; i < width; i++) {
-            // Y, U, V values for the pixel
-            unsigned char Y = y[j * width + i];
-            unsigned char U = u[(j / 2) * (width / 2) + (i / 2)];
-            unsigned char V = v[(j / 2) * (width / 2) + (i / 2)];
-
-            // Convert YUV to RGB
-            int R = Y + 1.402 * (V - 128);
-            int G = Y - 0.344136 * (U - 128) - 0.714136 * (V - 128);
-            int B = Y + 1.772 * (U - 128);
-
-            // Clamp RGB values to [0, 255]
-            if (R < 0) R = 0; if (R > 255) R = 255;
-            if (G < 0) G = 0; if (G > 255) G = 255;
-            if (B < 0) B = 0; if (B > 255) B = 255;
-
-            // Store RGB values in the buffer
-            rgb_buffer[buffer_index++] = R;
-            rgb_buffer[buffer_index++] = G;
-            rgb_buffer[buffer_index++] = B;
-        }
-    }
+    // Convert YUV to RGB with full-range BT.601 coefficients
+    if (!tables.depth)
+        easy_yuv_to_rgb_init(&tables, AVCOL_SPC_BT470BG, AVCOL_RANGE_JPEG, 8);
+    easy_yuv_to_rgb24_planes(&tables, data, linesize, width, height, 1, 1, rgb_buffer, 3 * width);
 
     // Write the entire buffer to the file at once
     fwrite(rgb_buffer, 1, 3 * width * height, f);
@@ -136,6 +125,35 @@ int easy_save_yuv_to_ppm(unsigned char* y, unsigned char* u, unsigned char* v, i
     return 0;   // Success
 }
 
+/**
+ * Save a decoded YUV frame as a PPM file, using the color matrix and range
+ * signalled in the frame.
+ * 
+ * @param frame The frame to save, see easy_yuv_to_rgb24() for the supported formats.
+ * @param filename The file name to save the PPM image to.
+ * 
+ * @note Unlike easy_save_yuv_to_ppm() this honors linesizes, BT.601/709/2020
+ *       matrices, limited range and 10-bit input.
+ * @note The conversion tables are kept per thread and only rebuilt when the
+ *       matrix, range or depth differ from the previous frame.
+ * 
+ * @return 0 on success, a negative value on failure.
+ */
+static inline int easy_save_frame_to_ppm(const AVFrame *frame, const char *filename) {
+    static EASY_THREAD_LOCAL EasyYuvToRgb tables; // zeroed, so built on the first frame
+    int ret;
+
+    unsigned char *rgb_buffer = (unsigned char *)malloc(3 * frame->width * frame->height);
+    if (!rgb_buffer) return AVERROR(ENOMEM);
+
+    EASY_TRACE_CALL("yuv_to_rgb", ret = easy_yuv_to_rgb24(&tables, frame, rgb_buffer, 3 * frame->width));
+    if (ret >= 0)
+        ret = easy_save_ppm(rgb_buffer, 3 * frame->width, frame->width, frame->height, (char *)filename);
+
+    free(rgb_buffer);
+    return ret;
+}
+
 /**
  * Save a grayscale image (PGM format).
  * 
@@ -181,8 +199,11 @@ static inline int easy_save_yuv420(unsigned char* y, int y_linesize,
                                    unsigned char* u, int u_linesize, 
                                    unsigned char* v, int v_linesize, 
                                    int width, int height, FILE *f) {
+    int64_t trace;
+
     if (!f) return -1;
 
+    trace = easy_trace_begin();
     for (int i = 0; i < height; i++) {
         fwrite(y + i * y_linesize, 1, width, f);
     }
@@ -194,6 +215,7 @@ static inline int easy_save_yuv420(unsigned char* y, int y_linesize,
     for (int i = 0; i < height / 2; i++) {
         fwrite(v + i * v_linesize, 1, width / 2, f);
     }
+    easy_trace_end(trace, "save");
     return 0;
 }
 
@@ -240,11 +262,181 @@ static inline void easy_reformat_to_rgb24(AVFrame *frame, unsigned char *rgb_buf
     }
 
     // Convert the YUV frame to RGB
-    sws_scale(sws_ctx, (const uint8_t *const *)frame->data, frame->linesize, 0, height, &rgb_buffer, &width);
+    EASY_TRACE_CALL("sws_scale",
+                    sws_scale(sws_ctx, (const uint8_t *const *)frame->data, frame->linesize, 0, height, &rgb_buffer, &width));
 
     // Free the conversion context
     sws_freeContext(sws_ctx);
 }
 
 
+/**
+ * A rectangle of a picture, in luma pixels.
+ */
+typedef struct EasyRect {
+    int x, y;
+    int width, height;
+} EasyRect;
+
+/**
+ * Reference the region of interest of a frame, without copying pixels.
+ *
+ * The plane pointers of dst are moved to the rectangle and its width and
+ * height set to the rectangle size, with av_frame_apply_cropping(), so
+ * anything taking an AVFrame then only touches the region. The rectangle
+ * is clipped to the picture and its top-left corner moved back to the
+ * chroma grid (even x and y for 4:2:0), growing it by the same amount, so
+ * chroma samples stay paired with their luma.
+ *
+ * @param dst An empty frame, set to the new reference.
+ * @param src The frame, relative to its visible picture if it still has cropping to apply.
+ * @param roi The region of interest.
+ * @param actual Set to the rectangle dst shows, may be NULL.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_frame_ref_roi(AVFrame *dst, const AVFrame *src, const EasyRect *roi, EasyRect *actual) {
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((enum AVPixelFormat)src->format);
+    int visible_w = src->width - (int)(src->crop_left + src->crop_right);
+    int visible_h = src->height - (int)(src->crop_top + src->crop_bottom);
+    int x0, y0, x1, y1, ret;
+
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM))) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot crop frames of this pixel format\n");
+        return AVERROR(ENOSYS);
+    }
+    x0 = FFMAX(roi->x, 0);
+    y0 = FFMAX(roi->y, 0);
+    x1 = FFMIN(roi->x + roi->width, visible_w);
+    y1 = FFMIN(roi->y + roi->height, visible_h);
+    /* crop_left >> log2_chroma_w must land on the chroma sample of the first pixel */
+    x0 &= ~((1 << desc->log2_chroma_w) - 1);
+    y0 &= ~((1 << desc->log2_chroma_h) - 1);
+    if (x1 <= x0 || y1 <= y0)
+        return AVERROR(EINVAL);
+
+    if ((ret = av_frame_ref(dst, src)) < 0)
+        return ret;
+    dst->crop_left   = src->crop_left + x0;
+    dst->crop_top    = src->crop_top + y0;
+    dst->crop_right  = src->crop_right + (visible_w - x1);
+    dst->crop_bottom = src->crop_bottom + (visible_h - y1);
+    /* exact pointers, the aligned mode would widen the region to the left */
+    if ((ret = av_frame_apply_cropping(dst, AV_FRAME_CROP_UNALIGNED)) < 0) {
+        av_frame_unref(dst);
+        return ret;
+    }
+    if (actual) {
+        actual->x      = x0;
+        actual->y      = y0;
+        actual->width  = x1 - x0;
+        actual->height = y1 - y0;
+    }
+    return 0;
+}
+
+/**
+ * Convert the region of interest of a frame to RGB24, only its pixels are
+ * read and converted.
+ *
+ * @param frame The frame.
+ * @param roi The region of interest, adjusted as in easy_frame_ref_roi().
+ * @param rgb_buffer The destination, at least rgb_linesize * roi height bytes.
+ * @param rgb_linesize The number of bytes in a row of the destination.
+ * @param sws A scaler kept between calls, may be NULL to create one per call.
+ * @param actual Set to the rectangle converted, may be NULL.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_reformat_roi_to_rgb24(const AVFrame *frame, const EasyRect *roi, unsigned char *rgb_buffer,
+                                             int rgb_linesize, struct SwsContext **sws, EasyRect *actual) {
+    struct SwsContext *local = NULL, **ctx = sws ? sws : &local;
+    AVFrame *crop = av_frame_alloc();
+    int ret;
+
+    if (!crop) return AVERROR(ENOMEM);
+    if ((ret = easy_frame_ref_roi(crop, frame, roi, actual)) < 0)
+        goto end;
+
+    *ctx = sws_getCachedContext(*ctx, crop->width, crop->height, (enum AVPixelFormat)crop->format,
+                                crop->width, crop->height, AV_PIX_FMT_RGB24, SWS_BILINEAR, NULL, NULL, NULL);
+    if (!*ctx) {
+        ret = AVERROR(EINVAL);
+        goto end;
+    }
+    EASY_TRACE_CALL("sws_scale", ret = sws_scale(*ctx, (const uint8_t *const *)crop->data, crop->linesize, 0,
+                                                 crop->height, &rgb_buffer, &rgb_linesize));
+
+end:
+    sws_freeContext(local);
+    av_frame_free(&crop);
+    return ret < 0 ? ret : 0;
+}
+
+/**
+ * Save the region of interest of a decoded YUV frame as a PPM file, see
+ * easy_save_frame_to_ppm(). The RGB buffer and the conversion are the size
+ * of the region, not of the frame.
+ *
+ * @param frame The frame to save.
+ * @param roi The region of interest, adjusted as in easy_frame_ref_roi().
+ * @param filename The file name to save the PPM image to.
+ *
+ * @return 0 on success, a negative value on failure.
+ */
+static inline int easy_save_frame_roi_to_ppm(const AVFrame *frame, const EasyRect *roi, const char *filename) {
+    AVFrame *crop = av_frame_alloc();
+    int ret;
+
+    if (!crop) return AVERROR(ENOMEM);
+    if ((ret = easy_frame_ref_roi(crop, frame, roi, NULL)) >= 0)
+        ret = easy_save_frame_to_ppm(crop, filename);
+    av_frame_free(&crop);
+    return ret;
+}
+
+/**
+ * Append the region of interest of a YUV420P frame to a raw YUV420P video,
+ * see easy_save_yuv420(). Odd region sizes keep their last chroma column
+ * and row.
+ *
+ * @param frame The frame to save.
+ * @param roi The region of interest, adjusted as in easy_frame_ref_roi().
+ * @param f The file pointer to save the YUV image to.
+ * @param actual Set to the rectangle written, which gives the video size, may be NULL.
+ *
+ * @return 0 on success, a negative AVERROR code on failure.
+ */
+static inline int easy_save_frame_roi_yuv420(const AVFrame *frame, const EasyRect *roi, FILE *f, EasyRect *actual) {
+    AVFrame *crop;
+    int64_t trace;
+    int ret;
+
+    if (!f) return AVERROR(EINVAL);
+    if (frame->format != AV_PIX_FMT_YUV420P && frame->format != AV_PIX_FMT_YUVJ420P) {
+        av_log(NULL, AV_LOG_ERROR, "Only YUV420P frames can be saved as YUV420P\n");
+        return AVERROR(EINVAL);
+    }
+    if (!(crop = av_frame_alloc())) return AVERROR(ENOMEM);
+    if ((ret = easy_frame_ref_roi(crop, frame, roi, actual)) < 0)
+        goto end;
+
+    trace = easy_trace_begin();
+    for (int p = 0; p < 3 && ret >= 0; p++) {
+        int w = p ? AV_CEIL_RSHIFT(crop->width, 1) : crop->width;
+        int h = p ? AV_CEIL_RSHIFT(crop->height, 1) : crop->height;
+        for (int i = 0; i < h; i++) {
+            if (fwrite(crop->data[p] + (ptrdiff_t)i * crop->linesize[p], 1, w, f) != (size_t)w) {
+                ret = AVERROR(EIO);
+                break;
+            }
+        }
+    }
+    easy_trace_end(trace, "save");
+
+end:
+    av_frame_free(&crop);
+    return ret;
+}
+
 #endif // __EASY_UTILS_H__
\ No newline at end of file
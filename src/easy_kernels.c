@@ -0,0 +1,119 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#include "easy_kernels_internal.h"
+
+#include <pthread.h>
+
+typedef struct EasyKernels {
+    const char *isa;
+    int      (*yuv_to_rgb24)(const EasyKernelYuvCoeffs *c, const uint8_t *const data[3],
+                             const int linesize[3], int width, int height,
+                             int log2_chroma_w, int log2_chroma_h,
+                             uint8_t *rgb, int rgb_linesize);
+    void     (*copy_plane)(uint8_t *dst, ptrdiff_t dst_linesize,
+                           const uint8_t *src, ptrdiff_t src_linesize,
+                           int bytewidth, int height);
+    uint64_t (*sad_plane)(const uint8_t *a, ptrdiff_t a_linesize,
+                          const uint8_t *b, ptrdiff_t b_linesize,
+                          int width, int height);
+} EasyKernels;
+
+#define EASY_KERNELS_ENTRY(isa) \
+    { #isa, easy_kernel_yuv_to_rgb24_##isa, easy_kernel_copy_plane_##isa, easy_kernel_sad_plane_##isa }
+
+/* ordered from the most portable to the fastest */
+static const EasyKernels easy_kernel_table[] = {
+    EASY_KERNELS_ENTRY(c),
+#if defined(EASY_KERNELS_X86)
+    EASY_KERNELS_ENTRY(avx2),
+    EASY_KERNELS_ENTRY(avx512),
+#endif
+};
+
+static const EasyKernels *easy_kernels_selected = &easy_kernel_table[0];
+static pthread_once_t easy_kernels_once = PTHREAD_ONCE_INIT;
+
+/* the highest entry of easy_kernel_table the CPU and OS can run */
+static int easy_kernels_cpu_level(void)
+{
+#if defined(EASY_KERNELS_X86) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512vl"))
+        return 2;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return 1;
+#endif
+    return 0;
+}
+
+static void easy_kernels_resolve(void)
+{
+    const char *env = getenv("EASY_KERNELS");
+    int level = easy_kernels_cpu_level();
+
+    /* a forced level may only lower the choice, never enable an unsupported ISA */
+    if (env) {
+        for (int i = 0; i <= level; i++) {
+            if (!strcmp(env, easy_kernel_table[i].isa)) {
+                level = i;
+                break;
+            }
+        }
+    }
+    easy_kernels_selected = &easy_kernel_table[level];
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+/* resolve when the library is loaded, so the first frame pays nothing */
+__attribute__((constructor)) static void easy_kernels_load(void)
+{
+    pthread_once(&easy_kernels_once, easy_kernels_resolve);
+}
+#endif
+
+static const EasyKernels *easy_kernels(void)
+{
+    pthread_once(&easy_kernels_once, easy_kernels_resolve);
+    return easy_kernels_selected;
+}
+
+int easy_kernel_yuv_to_rgb24(const EasyKernelYuvCoeffs *c, const uint8_t *const data[3],
+                             const int linesize[3], int width, int height,
+                             int log2_chroma_w, int log2_chroma_h,
+                             uint8_t *rgb, int rgb_linesize)
+{
+    return easy_kernels()->yuv_to_rgb24(c, data, linesize, width, height,
+                                        log2_chroma_w, log2_chroma_h, rgb, rgb_linesize);
+}
+
+void easy_kernel_copy_plane(uint8_t *dst, ptrdiff_t dst_linesize,
+                            const uint8_t *src, ptrdiff_t src_linesize,
+                            int bytewidth, int height)
+{
+    easy_kernels()->copy_plane(dst, dst_linesize, src, src_linesize, bytewidth, height);
+}
+
+uint64_t easy_kernel_sad_plane(const uint8_t *a, ptrdiff_t a_linesize,
+                               const uint8_t *b, ptrdiff_t b_linesize,
+                               int width, int height)
+{
+    return easy_kernels()->sad_plane(a, a_linesize, b, b_linesize, width, height);
+}
+
+const char *easy_kernels_isa(void)
+{
+    return easy_kernels()->isa;
+}
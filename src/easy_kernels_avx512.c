@@ -0,0 +1,20 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+
+/* kernels built for AVX-512 F/BW/VL, see CMakeLists.txt for the flags */
+#include "easy_kernels_internal.h"
+
+#define EASY_KERNEL(name) easy_kernel_##name##_avx512
+#include "easy_kernels_template.c"
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+#ifndef __EASY_KERNELS_INTERNAL_H__
+#define __EASY_KERNELS_INTERNAL_H__
+
+#include "easy_kernels.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define EASY_KERNEL_ALIGN(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
+/* one set of prototypes per instruction set the template is compiled for */
+#define EASY_KERNEL_DECLARE(isa)                                                                      \
+    int easy_kernel_yuv_to_rgb24_##isa(const EasyKernelYuvCoeffs *c, const uint8_t *const data[3],    \
+                                       const int linesize[3], int width, int height,                  \
+                                       int log2_chroma_w, int log2_chroma_h,                          \
+                                       uint8_t *rgb, int rgb_linesize);                               \
+    void easy_kernel_copy_plane_##isa(uint8_t *dst, ptrdiff_t dst_linesize,                           \
+                                      const uint8_t *src, ptrdiff_t src_linesize,                     \
+                                      int bytewidth, int height);                                     \
+    uint64_t easy_kernel_sad_plane_##isa(const uint8_t *a, ptrdiff_t a_linesize,                      \
+                                         const uint8_t *b, ptrdiff_t b_linesize,                      \
+                                         int width, int height);
+
+EASY_KERNEL_DECLARE(c)
+#if defined(EASY_KERNELS_X86)
+EASY_KERNEL_DECLARE(avx2)
+EASY_KERNEL_DECLARE(avx512)
+#endif
+
+#endif // __EASY_KERNELS_INTERNAL_H__
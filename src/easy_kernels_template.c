@@ -0,0 +1,156 @@
+/*
+ * Copyright 2025 Jack Lau
+ * Email: jacklau1222gm@gmail.com
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ */
+
+/*
+ * Portable kernel bodies, compiled once per instruction set. The including
+ * file defines EASY_KERNEL(name) to give the functions an ISA suffix and the
+ * build adds the matching -m flags, so the loops are vectorized for that ISA
+ * by the compiler. Keep the loops simple, branch free and on restrict
+ * pointers, that is what lets them vectorize.
+ */
+
+#ifndef EASY_KERNEL
+#error "define EASY_KERNEL(name) before including this file"
+#endif
+
+static inline uint8_t EASY_KERNEL(clip)(int32_t v)
+{
+    v >>= EASY_KERNEL_YUV_BITS;
+    return (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+/* per-pixel chroma terms of one row, the chroma samples repeated 1 << log2_chroma_w times */
+static void EASY_KERNEL(chroma_row)(const EasyKernelYuvCoeffs *c, const uint8_t *restrict u,
+                                    const uint8_t *restrict v, int width, int log2_chroma_w,
+                                    int32_t *restrict cr, int32_t *restrict cg, int32_t *restrict cb)
+{
+    const int32_t v_r = c->v_r, u_g = c->u_g, v_g = c->v_g, u_b = c->u_b;
+
+    if (log2_chroma_w == 0) {
+        for (int i = 0; i < width; i++) {
+            int32_t cu = u[i] - 128, cv = v[i] - 128;
+            cr[i] = cv * v_r;
+            cg[i] = cu * u_g + cv * v_g;
+            cb[i] = cu * u_b;
+        }
+    } else if (log2_chroma_w == 1) {
+        for (int k = 0; k < (width + 1) >> 1; k++) {
+            int32_t cu = u[k] - 128, cv = v[k] - 128;
+            cr[2 * k] = cr[2 * k + 1] = cv * v_r;
+            cg[2 * k] = cg[2 * k + 1] = cu * u_g + cv * v_g;
+            cb[2 * k] = cb[2 * k + 1] = cu * u_b;
+        }
+    } else {
+        for (int i = 0; i < width; i++) {
+            int32_t cu = u[i >> log2_chroma_w] - 128, cv = v[i >> log2_chroma_w] - 128;
+            cr[i] = cv * v_r;
+            cg[i] = cu * u_g + cv * v_g;
+            cb[i] = cu * u_b;
+        }
+    }
+}
+
+static void EASY_KERNEL(rgb_row)(const uint8_t *restrict y, const int32_t *restrict cr,
+                                 const int32_t *restrict cg, const int32_t *restrict cb,
+                                 int32_t y_mul, int32_t y_add, int width,
+                                 uint8_t *restrict r, uint8_t *restrict g, uint8_t *restrict b)
+{
+    for (int i = 0; i < width; i++) {
+        int32_t yy = y[i] * y_mul + y_add;
+        r[i] = EASY_KERNEL(clip)(yy + cr[i]);
+        g[i] = EASY_KERNEL(clip)(yy + cg[i]);
+        b[i] = EASY_KERNEL(clip)(yy + cb[i]);
+    }
+}
+
+static void EASY_KERNEL(interleave_row)(const uint8_t *restrict r, const uint8_t *restrict g,
+                                        const uint8_t *restrict b, int width, uint8_t *restrict dst)
+{
+    for (int i = 0; i < width; i++) {
+        dst[3 * i + 0] = r[i];
+        dst[3 * i + 1] = g[i];
+        dst[3 * i + 2] = b[i];
+    }
+}
+
+int EASY_KERNEL(yuv_to_rgb24)(const EasyKernelYuvCoeffs *c, const uint8_t *const data[3],
+                              const int linesize[3], int width, int height,
+                              int log2_chroma_w, int log2_chroma_h,
+                              uint8_t *rgb, int rgb_linesize)
+{
+    /* the row is split into passes the compiler vectorizes on their own:
+     * chroma terms, planar R/G/B, then the RGB24 interleave */
+    size_t aligned = EASY_KERNEL_ALIGN(width + 1, 64);
+    int32_t *terms = (int32_t *)malloc(aligned * (3 * sizeof(int32_t) + 3));
+    int32_t *cr, *cg, *cb;
+    uint8_t *r, *g, *b;
+    int chroma_row = -1;
+
+    if (!terms)
+        return -1;
+    cr = terms;
+    cg = cr + aligned;
+    cb = cg + aligned;
+    r  = (uint8_t *)(cb + aligned);
+    g  = r + aligned;
+    b  = g + aligned;
+
+    for (int j = 0; j < height; j++) {
+        const uint8_t *y = data[0] + (ptrdiff_t)j * linesize[0];
+        uint8_t *dst = rgb + (ptrdiff_t)j * rgb_linesize;
+
+        if (j >> log2_chroma_h != chroma_row) {
+            chroma_row = j >> log2_chroma_h;
+            EASY_KERNEL(chroma_row)(c, data[1] + (ptrdiff_t)chroma_row * linesize[1],
+                                    data[2] + (ptrdiff_t)chroma_row * linesize[2],
+                                    width, log2_chroma_w, cr, cg, cb);
+        }
+
+        EASY_KERNEL(rgb_row)(y, cr, cg, cb, c->y_mul, c->y_add, width, r, g, b);
+        EASY_KERNEL(interleave_row)(r, g, b, width, dst);
+    }
+
+    free(terms);
+    return 0;
+}
+
+void EASY_KERNEL(copy_plane)(uint8_t *dst, ptrdiff_t dst_linesize, const uint8_t *src, ptrdiff_t src_linesize,
+                             int bytewidth, int height)
+{
+    if (dst_linesize == src_linesize && src_linesize == bytewidth) {
+        memcpy(dst, src, (size_t)bytewidth * height);
+        return;
+    }
+    for (int j = 0; j < height; j++)
+        memcpy(dst + j * dst_linesize, src + j * src_linesize, bytewidth);
+}
+
+uint64_t EASY_KERNEL(sad_plane)(const uint8_t *a, ptrdiff_t a_linesize, const uint8_t *b, ptrdiff_t b_linesize,
+                                int width, int height)
+{
+    uint64_t total = 0;
+
+    for (int j = 0; j < height; j++) {
+        const uint8_t *restrict ra = a + j * a_linesize;
+        const uint8_t *restrict rb = b + j * b_linesize;
+        /* a row of 8-bit differences cannot overflow 32 bits below 16M pixels */
+        uint32_t sum = 0;
+
+        for (int i = 0; i < width; i++)
+            sum += (uint32_t)abs(ra[i] - rb[i]);
+        total += sum;
+    }
+    return total;
+}
@@ -0,0 +1,287 @@
+/*
+ * copyright (c) 2025 Jack Lau
+ *
+ * Throughput runner of the perf regression corpus: drives the easy_* helpers
+ * over every input, several times, and writes the timings as JSON for
+ * tools/perf_compare.py.
+ *
+ * FFmpeg version 5.1.4
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libavutil/avutil.h>
+#include <libavutil/time.h>
+#include "../include/easy_color.h"
+#include "../include/easy_decoder_pool.h"
+#include "../include/easy_framestats.h"
+#include "../include/easy_media.h"
+#include "../include/easy_sampler.h"
+#include "../include/easy_scene.h"
+#include "../include/easy_trace.h"
+
+#define PERF_DEFAULT_REPS 5
+#define PERF_SAMPLES      10 // timestamps of the sampling benchmark
+
+enum PerfBench {
+    PERF_DECODE,      ///< demux and decode every frame
+    PERF_DECODE_POOLED, ///< the same with the decoder taken from a warm EasyDecoderPool
+    PERF_DECODE_RGB,  ///< plus conversion to RGB24 with easy_yuv_to_rgb24()
+    PERF_SCENE,       ///< plus near-duplicate detection
+    PERF_FRAMESTATS,  ///< plus per-frame statistics on a worker pool
+    PERF_SAMPLE,      ///< seek-planned sampling of PERF_SAMPLES timestamps
+    PERF_NB
+};
+
+static const char *const perf_bench_names[PERF_NB] = {
+    "decode", "decode_pooled", "decode_rgb", "scene", "framestats", "sample",
+};
+
+typedef struct PerfContext {
+    enum PerfBench    bench;
+    int64_t           frames;
+    EasyYuvToRgb      yuv;
+    uint8_t          *rgb;
+    size_t            rgb_size;
+    EasySceneDetector scene;
+    EasyFrameStats    stats;
+    EasyDecoderPool  *decoder_pool;
+} PerfContext;
+
+static int perf_frame(PerfContext *ctx, AVFrame *frame)
+{
+    size_t size;
+    int ret = 0;
+
+    ctx->frames++;
+    switch (ctx->bench) {
+    case PERF_DECODE_RGB:
+        size = (size_t)3 * frame->width * frame->height;
+        if (size > ctx->rgb_size) {
+            av_freep(&ctx->rgb);
+            if (!(ctx->rgb = (uint8_t *)av_malloc(size)))
+                return AVERROR(ENOMEM);
+            ctx->rgb_size = size;
+        }
+        ret = easy_yuv_to_rgb24(&ctx->yuv, frame, ctx->rgb, 3 * frame->width);
+        break;
+    case PERF_SCENE:
+        ret = easy_scene_is_distinct(&ctx->scene, frame);
+        break;
+    case PERF_FRAMESTATS:
+        ret = easy_framestats_add(&ctx->stats, frame, (AVRational){ 1, 1 });
+        break;
+    default:
+        break;
+    }
+    return ret < 0 ? ret : 0;
+}
+
+static int perf_sample_cb(const AVFrame *frame, int index, double timestamp, void *opaque)
+{
+    (void)frame;
+    (void)index;
+    (void)timestamp;
+    ((PerfContext *)opaque)->frames++;
+    return 0;
+}
+
+/* one timed pass of a benchmark over a file, opening included */
+static int perf_run(PerfContext *ctx, const char *filename)
+{
+    AVFormatContext *fmt_ctx = NULL;
+    AVCodecContext *dec_ctx = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    EasyVideoOptions opts = { 0 };
+    int stream_index, ret;
+
+    ctx->frames = 0;
+    if (!pkt || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    opts.decoder_pool = ctx->decoder_pool;
+    if ((ret = easy_open_video2(filename, &fmt_ctx, &dec_ctx, &stream_index, &opts)) < 0)
+        goto end;
+
+    if (ctx->bench == PERF_SAMPLE) {
+        double duration = fmt_ctx->duration != AV_NOPTS_VALUE ? fmt_ctx->duration / (double)AV_TIME_BASE : 1;
+        double timestamps[PERF_SAMPLES];
+
+        for (int i = 0; i < PERF_SAMPLES; i++)
+            timestamps[i] = duration * i / PERF_SAMPLES;
+        ret = easy_sample_frames(fmt_ctx, dec_ctx, stream_index, timestamps, PERF_SAMPLES, perf_sample_cb, ctx,
+                                 NULL);
+        goto end;
+    }
+
+    /* a NULL packet at the end drains the decoder */
+    for (int eof = 0; !eof;) {
+        if ((ret = easy_read_frame(fmt_ctx, pkt)) == AVERROR_EOF)
+            eof = 1;
+        else if (ret < 0)
+            goto end;
+        else if (pkt->stream_index != stream_index) {
+            av_packet_unref(pkt);
+            continue;
+        }
+        ret = easy_send_packet(dec_ctx, eof ? NULL : pkt);
+        av_packet_unref(pkt);
+        if (ret < 0 && ret != AVERROR_INVALIDDATA)
+            goto end;
+        while ((ret = easy_receive_frame(dec_ctx, frame)) >= 0) {
+            ret = perf_frame(ctx, frame);
+            av_frame_unref(frame);
+            if (ret < 0)
+                goto end;
+        }
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            goto end;
+    }
+    ret = ctx->bench == PERF_FRAMESTATS ? easy_framestats_flush(&ctx->stats) : 0;
+
+end:
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    /* parked for the next repetition, which then skips avcodec_open2() */
+    if (ctx->decoder_pool)
+        easy_decoder_pool_release(ctx->decoder_pool, &dec_ctx);
+    avcodec_free_context(&dec_ctx);
+    avformat_close_input(&fmt_ctx);
+    return ret;
+}
+
+static void perf_json_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', f);
+        if ((unsigned char)*s >= 0x20)
+            fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+int main(int argc, char **argv)
+{
+    const char *output = "perf.json", *label = "";
+    unsigned version = avcodec_version();
+    int reps = PERF_DEFAULT_REPS, first = 1, nb_results = 0, i;
+    char date[32];
+    time_t now = time(NULL);
+    FILE *f;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i += 2) {
+        if (i + 1 >= argc)
+            break;
+        if (!strcmp(argv[i], "-r"))
+            reps = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-o"))
+            output = argv[i + 1];
+        else if (!strcmp(argv[i], "-l"))
+            label = argv[i + 1];
+        else
+            break;
+    }
+    if (i >= argc || reps < 2) {
+        fprintf(stderr, "Usage: %s [-r repetitions (>= 2, default %d)] [-o output.json] [-l label] <input files>\n",
+                argv[0], PERF_DEFAULT_REPS);
+        return 1;
+    }
+    if (!(f = fopen(output, "w"))) {
+        fprintf(stderr, "Cannot open %s\n", output);
+        return 1;
+    }
+    av_log_set_level(AV_LOG_ERROR);
+
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    fprintf(f, "{\"label\":");
+    perf_json_string(f, label);
+    fprintf(f, ",\"date\":\"%s\",\"ffmpeg\":", date);
+    perf_json_string(f, av_version_info());
+    fprintf(f, ",\"libavcodec\":\"%u.%u.%u\",\"kernels\":\"%s\",\"results\":[", AV_VERSION_MAJOR(version),
+            AV_VERSION_MINOR(version), AV_VERSION_MICRO(version),
+#if defined(EASY_HAVE_KERNELS)
+            easy_kernels_isa()
+#else
+            "header"
+#endif
+    );
+
+    for (; i < argc; i++) {
+        for (int b = 0; b < PERF_NB; b++) {
+            PerfContext ctx;
+            double seconds[64], best;
+            int n = FFMIN(reps, 64), ret = 0;
+
+            memset(&ctx, 0, sizeof(ctx));
+            ctx.bench = (enum PerfBench)b;
+            /* the untimed warm-up misses and parks the decoder, the timed passes hit */
+            if (b == PERF_DECODE_POOLED && (ret = easy_decoder_pool_alloc(&ctx.decoder_pool, 1)) < 0) {
+                fprintf(stderr, "Cannot allocate the decoder pool\n");
+                return 1;
+            }
+
+            /* the untimed first pass warms the page cache and the allocators */
+            for (int r = -1; r < n && ret >= 0; r++) {
+                int64_t start;
+
+                if (b == PERF_FRAMESTATS && (ret = easy_framestats_init(&ctx.stats, 0)) < 0)
+                    break;
+                easy_scene_init(&ctx.scene, EASY_SCENE_DEFAULT_SAD_THRESHOLD, EASY_SCENE_DEFAULT_HIST_THRESHOLD);
+                start = av_gettime_relative();
+                ret = perf_run(&ctx, argv[i]);
+                if (r >= 0)
+                    seconds[r] = (av_gettime_relative() - start) / 1000000.0;
+                if (b == PERF_FRAMESTATS)
+                    easy_framestats_uninit(&ctx.stats);
+                easy_scene_uninit(&ctx.scene);
+            }
+            av_freep(&ctx.rgb);
+            if (ctx.decoder_pool) {
+                EasyDecoderPoolStats pool_stats;
+
+                easy_decoder_pool_get_stats(ctx.decoder_pool, &pool_stats);
+                if (ret >= 0)
+                    printf("%-40s %-13s open %.2f ms cold, %.2f ms warm (%llu hits)\n", argv[i],
+                           perf_bench_names[b], pool_stats.open_ms, pool_stats.reuse_ms,
+                           (unsigned long long)pool_stats.hits);
+                easy_decoder_pool_free(&ctx.decoder_pool);
+            }
+
+            /* e.g. easy_yuv_to_rgb24() does not take every pixel format */
+            if (ret < 0) {
+                char err[128];
+                av_strerror(ret, err, sizeof(err));
+                fprintf(stderr, "%s %s: skipped, %s\n", argv[i], perf_bench_names[b], err);
+                continue;
+            }
+
+            fprintf(f, "%s{\"file\":", first ? "" : ",");
+            perf_json_string(f, argv[i]);
+            fprintf(f, ",\"bench\":\"%s\",\"frames\":%lld,\"seconds\":[", perf_bench_names[b],
+                    (long long)ctx.frames);
+            best = seconds[0];
+            for (int r = 0; r < n; r++) {
+                fprintf(f, "%s%.6f", r ? "," : "", seconds[r]);
+                best = FFMIN(best, seconds[r]);
+            }
+            fprintf(f, "]}");
+            first = 0;
+            nb_results++;
+
+            printf("%-40s %-13s %8lld frames %8.1f fps (best of %d)\n", argv[i], perf_bench_names[b],
+                   (long long)ctx.frames, ctx.frames / best, n);
+        }
+    }
+    fprintf(f, "]}\n");
+    if (fclose(f)) {
+        fprintf(stderr, "Cannot write %s\n", output);
+        return 1;
+    }
+    return !nb_results;
+}
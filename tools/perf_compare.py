@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+#
+# copyright (c) 2025 Jack Lau
+#
+# Compare two runs of tools/easy_perf and flag statistically significant
+# slowdowns with a one-sided Welch t-test per (file, benchmark). Standard
+# library only, so it runs wherever the runner does.
+#
+# usage: perf_compare.py [--alpha 0.01] [--min-change 0.02] base.json new.json
+#
+# Exits with 1 when at least one benchmark got slower.
+
+import argparse
+import json
+import math
+import os
+import sys
+
+
+def betacf(a, b, x):
+    """Continued fraction of the incomplete beta function (modified Lentz)."""
+    tiny = 1e-300
+    qab, qap, qam = a + b, a + 1.0, a - 1.0
+    c, d = 1.0, 1.0 - qab * x / qap
+    d = 1.0 / (d if abs(d) > tiny else tiny)
+    h = d
+    for m in range(1, 300):
+        m2 = 2 * m
+        aa = m * (b - m) * x / ((qam + m2) * (a + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > tiny else tiny)
+        c = 1.0 + aa / c
+        c = c if abs(c) > tiny else tiny
+        h *= d * c
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > tiny else tiny)
+        c = 1.0 + aa / c
+        c = c if abs(c) > tiny else tiny
+        delta = d * c
+        h *= delta
+        if abs(delta - 1.0) < 1e-12:
+            break
+    return h
+
+
+def betainc(a, b, x):
+    """Regularized incomplete beta function I_x(a, b)."""
+    if x <= 0.0:
+        return 0.0
+    if x >= 1.0:
+        return 1.0
+    front = math.exp(math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b) +
+                     a * math.log(x) + b * math.log1p(-x))
+    if x < (a + 1.0) / (a + b + 2.0):
+        return front * betacf(a, b, x) / a
+    return 1.0 - front * betacf(b, a, 1.0 - x) / b
+
+
+def welch(base, new):
+    """One-sided p-value of mean(new) > mean(base), and the relative change."""
+    n1, n2 = len(base), len(new)
+    m1, m2 = sum(base) / n1, sum(new) / n2
+    v1 = sum((x - m1) ** 2 for x in base) / (n1 - 1)
+    v2 = sum((x - m2) ** 2 for x in new) / (n2 - 1)
+    change = (m2 - m1) / m1 if m1 > 0 else 0.0
+    se2 = v1 / n1 + v2 / n2
+    if se2 == 0.0:
+        # identical timings in both runs, any difference is exact
+        return (0.0 if m2 > m1 else 1.0), change
+    t = (m2 - m1) / math.sqrt(se2)
+    df = se2 ** 2 / ((v1 / n1) ** 2 / (n1 - 1) + (v2 / n2) ** 2 / (n2 - 1))
+    tail = 0.5 * betainc(df / 2.0, 0.5, df / (df + t * t))
+    return (tail if t > 0 else 1.0 - tail), change
+
+
+def load(path):
+    with open(path) as f:
+        run = json.load(f)
+    results = {}
+    for r in run.get("results", []):
+        # the corpus may live in another directory on the other machine
+        key = (os.path.basename(r["file"]), r["bench"])
+        results[key] = r
+    return run, results
+
+
+def describe(run):
+    return "%s FFmpeg %s, libavcodec %s, kernels %s, %s" % (
+        run.get("label") or "-", run.get("ffmpeg"), run.get("libavcodec"),
+        run.get("kernels"), run.get("date"))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Flag slowdowns between two easy_perf runs.")
+    parser.add_argument("base", help="JSON of the reference run")
+    parser.add_argument("new", help="JSON of the run to check")
+    parser.add_argument("--alpha", type=float, default=0.01,
+                        help="significance level of the one-sided test (default 0.01)")
+    parser.add_argument("--min-change", type=float, default=0.02,
+                        help="ignore slowdowns below this fraction of the base time (default 0.02)")
+    args = parser.parse_args()
+
+    base_run, base = load(args.base)
+    new_run, new = load(args.new)
+    print("base: " + describe(base_run))
+    print("new:  " + describe(new_run))
+    print()
+    print("%-36s %-11s %10s %10s %8s %9s  %s" % ("file", "bench", "base fps", "new fps", "change", "p", ""))
+
+    regressions = 0
+    for key in sorted(set(base) & set(new)):
+        b, n = base[key], new[key]
+        if b["frames"] != n["frames"]:
+            # a decoder change can add or drop frames, time per frame is still comparable
+            print("%-36s %-11s frame count changed %d -> %d" % (key[0], key[1], b["frames"], n["frames"]))
+        bs = [s / max(b["frames"], 1) for s in b["seconds"]]
+        ns = [s / max(n["frames"], 1) for s in n["seconds"]]
+        if len(bs) < 2 or len(ns) < 2:
+            continue
+        p, change = welch(bs, ns)
+        slower = p < args.alpha and change > args.min_change
+        faster = welch(ns, bs)[0] < args.alpha and -change > args.min_change
+        regressions += slower
+        print("%-36s %-11s %10.1f %10.1f %+7.1f%% %9.2g  %s" % (
+            key[0][:36], key[1], len(bs) / sum(bs), len(ns) / sum(ns), 100 * change, p,
+            "SLOWER" if slower else "faster" if faster else ""))
+
+    for key in sorted(set(base) - set(new)):
+        print("%-36s %-11s missing from the new run" % key)
+
+    print()
+    print("%d significant slowdown(s) at alpha %g" % (regressions, args.alpha))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
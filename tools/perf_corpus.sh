@@ -0,0 +1,50 @@
+#!/bin/bash
+#
+# Generate the reference corpus of tools/easy_perf with FFmpeg's own
+# encoders and lavfi sources, nothing is downloaded.
+#
+# usage: tools/perf_corpus.sh [output dir (default perf_corpus)]
+#
+# Generate it once and keep it: encoders change between FFmpeg releases, so
+# runs are only comparable on the same files. FFMPEG selects the binary,
+# DURATION the clip length in seconds.
+
+set -e
+
+FFMPEG=${FFMPEG:-ffmpeg}
+DURATION=${DURATION:-10}
+OUT=${1:-perf_corpus}
+
+mkdir -p "$OUT"
+"$FFMPEG" -hide_banner -version | head -n 1 > "$OUT/GENERATED_BY"
+
+# name, lavfi source, size, pixel format, then encoder options
+gen() {
+    local name=$1 src=$2 size=$3 pix_fmt=$4
+    shift 4
+    if [ -f "$OUT/$name" ]; then
+        echo "keep     $name"
+        return
+    fi
+    echo "generate $name"
+    "$FFMPEG" -hide_banner -loglevel error -nostdin -y \
+        -f lavfi -i "$src=size=$size:rate=25" -t "$DURATION" \
+        -pix_fmt "$pix_fmt" "$@" -fflags +bitexact -flags:v +bitexact "$OUT/$name"
+}
+
+# codecs decoded by FFmpeg itself, from SD to 1080p, 8 and 10 bit, 4:2:0 and 4:2:2
+gen mpeg2_576p_yuv420p.mpg         testsrc2    720x576   yuv420p     -c:v mpeg2video -b:v 6M -g 12
+gen mpeg4_720p_yuv420p.mp4         mandelbrot  1280x720  yuv420p     -c:v mpeg4 -q:v 3 -g 250
+gen mjpeg_1080p_yuvj422p.avi       testsrc2    1920x1080 yuvj422p    -c:v mjpeg -q:v 3
+gen ffv1_1080p_yuv420p10le.mkv     testsrc2    1920x1080 yuv420p10le -c:v ffv1 -level 3 -slices 4
+gen prores_720p_yuv422p10le.mov    smptehdbars 1280x720  yuv422p10le -c:v prores_ks -profile:v 2
+gen ffvhuff_576p_yuv420p.mkv       smptebars   720x576   yuv420p     -c:v ffvhuff
+
+# H.264 is the most common input, but its encoder is an external library
+if "$FFMPEG" -hide_banner -encoders 2>/dev/null | grep -q libx264; then
+    gen h264_1080p_yuv420p.mp4     testsrc2    1920x1080 yuv420p     -c:v libx264 -preset medium -crf 23 -g 250
+else
+    echo "skip     h264_1080p_yuv420p.mp4, no libx264"
+fi
+
+echo "corpus in $OUT, generated by $(cat "$OUT/GENERATED_BY")"